@@ -70,6 +70,11 @@ typedef enum {
    attr_stribog512,
    attr_growing,
    attr_compressed,
+   attr_btime,
+   attr_blake3,
+   attr_xxh3,
+   attr_crc32c,
+   attr_trustctime,
    attr_unknown
 } ATTRIBUTE;
 
@@ -57,6 +57,8 @@ bool do_repurldef(char*, int, char*, char*);
 bool do_rootprefix(char*, int, char*, char*);
 
 long do_num_workers(const char *);
+long long do_number(const char *);
+long long do_size(const char *);
 
 #ifdef WITH_E2FSATTRS
 void do_report_ignore_e2fsattrs(char*, int, char*, char*);
@@ -53,6 +53,29 @@ typedef enum config_option {
     REPORT_FORMAT_OPTION,
     LIMIT_CMDLINE_OPTION,
     NUM_WORKERS,
+    NUM_SCAN_WORKERS,
+    NUM_TREE_WORKERS,
+    SCAN_DIRFD_OPTION,
+    IO_URING_OPTION,
+    SCAN_INODE_ORDER_OPTION,
+    HASH_ORDER_WINDOW_OPTION,
+    DEVICE_QUEUES_OPTION,
+    ROTATIONAL_DEVICE_WORKERS_OPTION,
+    NETWORK_DEVICE_WORKERS_OPTION,
+    DEVICE_WORKERS_OPTION,
+    READ_BLOCK_SIZE_OPTION,
+    MMAP_THRESHOLD_OPTION,
+    SMALL_FILE_THRESHOLD_OPTION,
+    SMALL_FILE_INLINE_OPTION,
+    DIRECT_IO_OPTION,
+    DROP_PAGE_CACHE_OPTION,
+    PREFETCH_FILES_OPTION,
+    PIPELINE_THRESHOLD_OPTION,
+    HASH_THREADS_THRESHOLD_OPTION,
+    NATIVE_HASHSUMS_OPTION,
+    SMALL_FILE_BATCH_OPTION,
+    BLAKE3_THREADS_OPTION,
+    HASH_CACHE_OPTION,
 } config_option;
 
 typedef struct {
@@ -66,5 +66,6 @@ void free_db_line(db_line* dl);
 #define NODE_PARENT_POSTIVE_MATCH  (1<<17)
 #define NODE_PARENT_NEGATIVE_MATCH (1<<18)
 #define NODE_PARENT_NO_RULE_MATCH  (1<<19)
+#define NODE_HASHSUMS_CARRIED_OVER (1<<20)
 
 #endif
@@ -152,6 +152,32 @@ typedef struct db_config {
   int action;
 
   long num_workers;
+  long num_scan_workers;
+  long num_tree_workers;
+  bool scan_dirfd;
+  bool scan_inode_order;
+  long hash_order_window;
+  bool device_queues;
+  long rotational_device_workers;
+  long network_device_workers;
+  long device_workers;
+  long long read_block_size;
+  long long mmap_threshold;
+  long long small_file_threshold;
+  bool small_file_inline;
+  bool direct_io;
+  bool drop_page_cache;
+  long prefetch_files;
+  long long pipeline_threshold;
+  long long hash_threads_threshold;
+  bool native_hashsums;
+  long small_file_batch;
+  long blake3_threads;
+  char *hash_cache;
+  bool io_uring;
+#ifdef HAVE_STATX
+  unsigned int statx_mask;
+#endif
 
   int progress;
   bool no_color;
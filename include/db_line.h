@@ -68,6 +68,7 @@ typedef struct db_line {
   time_t atime;
   time_t ctime;
   time_t mtime;
+  time_t btime;
   long inode; /* ino_t */
   long nlink; /* nlink_t */
 
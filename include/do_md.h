@@ -28,8 +28,34 @@
 #include "db_config.h"
 #include "md.h"
 
+/* maximum number of files hashed at once by calc_small_hashsums() */
+#define SMALL_FILES_BATCH_SIZE 16
+
+typedef struct small_hash_request {
+    char *fullpath;
+    DB_ATTR_TYPE attr;
+    struct stat *fs;
+
+    md_hashsums hashsums;
+    bool done; /* false: hashsums have to be calculated by calc_hashsums() */
+} small_hash_request;
+
 list* do_md(list* file_lst,db_config* conf);
 md_hashsums calc_hashsums(char*, DB_ATTR_TYPE, struct stat*, ssize_t, bool);
+void prefetch_file(char *, struct stat *);
+bool get_hardlink_hashsums(char *, DB_ATTR_TYPE, struct stat *, md_hashsums *);
+void add_hardlink_hashsums(struct stat *, md_hashsums *);
+void log_hardlink_cache_stats(void);
+bool is_small_file(struct stat *);
+void log_small_file_stats(void);
+void calc_small_hashsums(small_hash_request *, int);
+int stat_cmp(struct stat*, struct stat*, bool);
+/* btime (may be NULL) is set to the birth time of the file or 0 if not available */
+int stat_masked(int, const char *, struct stat *, time_t *, int);
+#ifdef HAVE_STATX
+unsigned int get_statx_mask(DB_ATTR_TYPE);
+void statx2stat(struct statx *, unsigned int, struct stat *);
+#endif
 
 #ifdef WITH_ACL
 void acl2line(db_line* line);
@@ -0,0 +1,44 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _HASH_CACHE_H_INCLUDED
+#define _HASH_CACHE_H_INCLUDED
+
+#include <stdbool.h>
+#include "attributes.h"
+#include "md.h"
+struct stat;
+
+/*
+ * persistent hash cache (see hash_cache config option), maps device, inode,
+ * size, mtime and ctime of a file to its previously calculated hashsums
+ */
+
+/* maps the cache file (a missing or invalid file is treated as empty cache) */
+void hash_cache_open(const char *);
+/* returns true if the hashsums of attr have been found in the cache (hs may be NULL) */
+bool get_cached_hashsums(char *, DB_ATTR_TYPE, struct stat *, md_hashsums *);
+void add_cached_hashsums(struct stat *, md_hashsums *);
+/* atomically replaces the cache file, unused entries are dropped unless keep_unused is set */
+bool hash_cache_write(bool);
+void hash_cache_close(void);
+void log_hash_cache_stats(void);
+
+#endif
@@ -43,6 +43,9 @@ typedef enum {
     hash_gostr3411_94,
     hash_stribog256,
     hash_stribog512,
+    hash_blake3,
+    hash_xxh3,
+    hash_crc32c,
     num_hashes,
 } HASHSUM;
 
@@ -51,8 +54,14 @@ typedef enum {
 
 extern hashsum_t hashsums[];
 
+/* algorithms[] value of hashsums only provided by native_hash.c */
+#define NATIVE_ONLY_ALGORITHM -2
+
 extern int algorithms[];
 
+/* hashsums supported by libgcrypt/mhash (or all hashsums if include_unsupported is set) */
 DB_ATTR_TYPE get_hashes(bool);
+/* hashsums which can be calculated (get_hashes(false) and the built-in only hashsums) */
+DB_ATTR_TYPE get_available_hashes(void);
 
 #endif /* _HASHSUM_H_INCLUDED */
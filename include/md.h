@@ -32,7 +32,9 @@
 #include <sys/types.h>
 #include "attributes.h"
 #include "hashsum.h"
+#include "native_hash.h"
 struct db_line;
+struct md_threads;
 
 /*
   This struct hold's internal data needed for md-calls.
@@ -50,6 +52,12 @@ typedef struct md_container {
   */
   DB_ATTR_TYPE todo_attr;
 
+  /*
+    Attr which are calculated by the built-in implementations.
+  */
+  DB_ATTR_TYPE native_attr;
+  native_hash_ctx native[num_hashes];
+
   /*
     Variables needed to cope with the library.
    */
@@ -61,6 +69,11 @@ typedef struct md_container {
   gcry_md_hd_t mdh;
 #endif
 
+  /*
+    Hashing threads (one per hashsum), NULL if hashsums are calculated sequentially.
+   */
+  struct md_threads *threads;
+
 } md_container;
 
 typedef struct md_hashsums {
@@ -70,6 +83,12 @@ typedef struct md_hashsums {
 
 int init_md(struct md_container*, const char*);
 int update_md(struct md_container*,void*,ssize_t);
+void start_md_threads(struct md_container*, const char*);
+/* returns true if the data passed to update_md() is read by other threads (md threads or blake3_threads) */
+bool md_uses_threads(struct md_container*);
+bool use_native_hash(HASHSUM);
+/* returns true if native_hash_sha256_multi() should be used for small files */
+bool use_native_sha256_multi(void);
 int close_md(struct md_container*, md_hashsums *, const char*);
 void hashsums2line(md_hashsums*, struct db_line*);
 
@@ -0,0 +1,68 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _NATIVE_HASH_H_INCLUDED
+#define _NATIVE_HASH_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hashsum.h"
+
+struct blake3_state;
+struct xxh3_state;
+
+/* built-in implementations of common hashsums (see native_hashsums) */
+typedef struct native_hash_ctx {
+    HASHSUM hashsum;
+    uint64_t length; /* number of bytes processed */
+    size_t buffer_length;
+    union {
+        uint32_t sha1[5];
+        uint32_t sha256[8];
+        uint64_t sha512[8];
+        uint32_t crc32;
+        struct blake3_state *blake3; /* freed in native_hash_final */
+        struct xxh3_state *xxh3; /* freed in native_hash_final */
+    } state;
+    unsigned char buffer[128];
+} native_hash_ctx;
+
+bool native_hash_available(HASHSUM);
+/* returns the name of the implementation selected for the CPU (e.g. "sha-ni") */
+const char *native_hash_implementation(HASHSUM);
+/* returns true if the implementation selected for the CPU is faster than the crypto library */
+bool native_hash_faster(HASHSUM);
+
+/* returns true if native_hash_sha256_multi() hashes several messages at once */
+bool native_hash_sha256_multi_buffer(void);
+/* selects the multi-buffer implementation even if SHA-NI is faster (for testing), returns false if not available */
+bool native_hash_force_sha256_multi_buffer(void);
+/* calculates the sha256 hashsums of independent messages */
+void native_hash_sha256_multi(const unsigned char * const *, const size_t *, size_t, unsigned char (*)[32]);
+
+void native_hash_init(native_hash_ctx *, HASHSUM);
+/* sets the number of threads used for large updates (blake3 only) */
+void native_hash_set_threads(native_hash_ctx *, int);
+void native_hash_update(native_hash_ctx *, const void *, size_t);
+/* writes hashsums[hashsum].length bytes, has to be called for every initialized context */
+void native_hash_final(native_hash_ctx *, unsigned char *);
+
+#endif
@@ -104,6 +104,7 @@ typedef struct report_t {
 
     long ntotal;
     long nadd, nrem, nchg;
+    long ncarried;
 
     diff_attrs_entry *diff_attrs_entries;
     int num_diff_attrs_entries;
@@ -121,6 +122,7 @@ void report_printf(report_t*, const char*, ...)
 ;
 
 typedef struct report_format_module {
+    void (*print_report_carried_over_entries)(report_t*, seltree*);
     void (*print_report_config_options)(report_t*);
     void (*print_report_databases)(report_t*);
     void (*print_report_details)(report_t*, seltree*);
@@ -142,6 +144,7 @@ char* get_summary_string(report_t*);
 const char* get_report_level_string(REPORT_LEVEL);
 int get_attribute_values(DB_ATTR_TYPE, db_line*,char* **, report_t*);
 void print_databases_attrs(report_t *, void (*)(report_t *, db_line*));
+void print_carried_over_entries(report_t*, seltree*, void (*)(report_t*, char*));
 void print_dbline_attrs(report_t *, db_line*, db_line*, DB_ATTR_TYPE, void (*)(report_t *, db_line*, db_line*, ATTRIBUTE));
 void print_report_config_options(report_t *, void (*)(report_t *, config_option, const char*));
 void print_report_details(report_t *, seltree*, void (*)(report_t *, db_line*, db_line*, DB_ATTR_TYPE));
@@ -0,0 +1,49 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _RING_H_INCLUDED
+#define _RING_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* bounded lock-free multi-producer multi-consumer queue (FIFO) */
+typedef struct ring_s ring_ts_t;
+
+ring_ts_t *ring_ts_init(size_t);
+void   ring_ts_free(ring_ts_t *);
+size_t ring_ts_capacity(ring_ts_t * const);
+size_t ring_ts_size(ring_ts_t * const);
+
+/* returns false if the queue is full */
+bool   ring_ts_try_enqueue(ring_ts_t * const, void * const);
+/* blocks while the queue is full */
+void   ring_ts_enqueue(ring_ts_t * const, void * const, const char *);
+
+/* returns NULL if the queue is currently empty */
+void  *ring_ts_dequeue(ring_ts_t * const, const char *);
+/* returns NULL if the queue is empty and released */
+void  *ring_ts_dequeue_wait(ring_ts_t * const, const char *);
+/* returns 0 if the queue is empty and released */
+size_t ring_ts_dequeue_batch_wait(ring_ts_t * const, void **, size_t, const char *);
+
+void   ring_ts_release(ring_ts_t * const, const char *);
+
+#endif
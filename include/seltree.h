@@ -37,4 +37,5 @@ match_t check_seltree(seltree *, char *, RESTRICTION_TYPE, bool);
 
 void log_tree(LOG_LEVEL, seltree *, int);
 bool is_tree_empty(seltree *);
+DB_ATTR_TYPE get_tree_attributes(seltree *);
 #endif /* _SELTREE_H_INCLUDED*/
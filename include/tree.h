@@ -33,4 +33,7 @@ tree_node *tree_walk_next(tree_node *);
 
 void *tree_get_data(tree_node *n);
 
+/* frees all nodes, free_data (if not NULL) is called for the data of each node */
+void tree_free(tree_node *, void (*)(void *));
+
 #endif
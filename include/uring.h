@@ -0,0 +1,49 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _URING_H_INCLUDED
+#define _URING_H_INCLUDED
+
+#include "config.h"
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "attributes.h"
+#include "md.h"
+
+/* maximum number of files processed at once by a single engine */
+#define URING_MAX_FILES 16
+
+typedef struct uring_engine uring_engine;
+
+typedef struct uring_hash_request {
+    char *fullpath;
+    DB_ATTR_TYPE attr;
+    struct stat *fs;
+
+    md_hashsums hashsums;
+    bool done; /* false: hashsums have to be calculated by calc_hashsums() */
+} uring_hash_request;
+
+uring_engine *uring_engine_init(const char *);
+void uring_engine_free(uring_engine *);
+
+void uring_calc_hashsums(uring_engine *, uring_hash_request *, int);
+
+#endif /* _URING_H_INCLUDED */
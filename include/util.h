@@ -82,6 +82,7 @@ const char* btoa(bool);
 
 void* checked_malloc(size_t);
 void* checked_calloc(size_t, size_t);
+void* checked_aligned_alloc(size_t, size_t);
 void* checked_strdup(const char *);
 void* checked_strndup(const char *, size_t);
 void* checked_realloc(void *, size_t);
@@ -54,6 +54,8 @@
 #include "seltree.h"
 #include "errorcodes.h"
 #include "gen_list.h"
+#include "do_md.h"
+#include "hash_cache.h"
 #include "getopt.h"
 #include "util.h"
 /*for locale support*/
@@ -201,7 +203,7 @@ static void print_version(void)
   EXTRA_ATTR(attr_capabilities)
 
   fprintf(stdout, "\nAvailable hashsum attributes:\n");
-  DB_ATTR_TYPE available_hashsums = get_hashes(false);
+  DB_ATTR_TYPE available_hashsums = get_available_hashes();
   for (int i = 0; i < num_hashes; ++i) {
       fprintf(stdout, "%s: %s\n", attributes[hashsums[i].attribute].config_name, ATTR(hashsums[i].attribute)&available_hashsums?"yes":"no");
   }
@@ -520,6 +522,29 @@ static void setdefaults_before_config(void)
   conf->action=0;
 
   conf->num_workers = -1;
+  conf->num_scan_workers = -1;
+  conf->num_tree_workers = -1;
+  conf->scan_dirfd = false;
+  conf->scan_inode_order = false;
+  conf->hash_order_window = 0;
+  conf->device_queues = false;
+  conf->rotational_device_workers = 2;
+  conf->network_device_workers = 0;
+  conf->device_workers = 0;
+  conf->read_block_size = 16777216;
+  conf->mmap_threshold = 0;
+  conf->small_file_threshold = 16384;
+  conf->small_file_inline = false;
+  conf->direct_io = false;
+  conf->drop_page_cache = false;
+  conf->prefetch_files = 0;
+  conf->pipeline_threshold = 0;
+  conf->hash_threads_threshold = 0;
+  conf->native_hashsums = true;
+  conf->small_file_batch = 0;
+  conf->blake3_threads = 1;
+  conf->hash_cache = NULL;
+  conf->io_uring = false;
 
   conf->warn_dead_symlinks=0;
 
@@ -571,15 +596,15 @@ static void setdefaults_before_config(void)
 
   DB_ATTR_TYPE GROUP_R_HASHES=0LLU;
 #ifdef WITH_MHASH
-  GROUP_R_HASHES=ATTR(attr_md5);
+  GROUP_R_HASHES=ATTR(attr_md5)|ATTR(attr_blake3);
 #endif
 #ifdef WITH_GCRYPT
   if (gcry_fips_mode_active()) {
     char* str;
-    log_msg(LOG_LEVEL_NOTICE, "libgcrypt is running in FIPS mode, the following hash(es) are not available: %s", str = diff_attributes(0, ATTR(attr_md5)));
+    log_msg(LOG_LEVEL_NOTICE, "libgcrypt is running in FIPS mode, the following hash(es) are not available: %s", str = diff_attributes(0, ATTR(attr_md5)|ATTR(attr_blake3)));
     free(str);
   } else {
-    GROUP_R_HASHES = ATTR(attr_md5);
+    GROUP_R_HASHES = ATTR(attr_md5)|ATTR(attr_blake3);
   }
 #endif
 
@@ -625,6 +650,23 @@ static void setdefaults_after_config(void)
       log_msg(LOG_LEVEL_CONFIG, "(default): set 'num_workers' option to %lu", conf->num_workers);
   }
 
+  if(conf->num_scan_workers < 0) {
+      conf->num_scan_workers = 0;
+      log_msg(LOG_LEVEL_CONFIG, "(default): set 'num_scan_workers' option to %lu", conf->num_scan_workers);
+  }
+
+  if(conf->num_tree_workers < 0) {
+      conf->num_tree_workers = 1;
+      log_msg(LOG_LEVEL_CONFIG, "(default): set 'num_tree_workers' option to %lu", conf->num_tree_workers);
+  }
+
+#ifndef WITH_URING
+  if (conf->io_uring) {
+      log_msg(LOG_LEVEL_WARNING, "io_uring support is not compiled in, ignore 'io_uring' option");
+      conf->io_uring = false;
+  }
+#endif
+
   if (is_log_level_unset()) {
           set_log_level(LOG_LEVEL_WARNING);
   };
@@ -730,6 +772,11 @@ int main(int argc,char**argv)
   log_msg(LOG_LEVEL_RULE, "rule tree:");
   log_tree(LOG_LEVEL_RULE, conf->tree, 0);
 
+#ifdef HAVE_STATX
+  conf->statx_mask = get_statx_mask(get_tree_attributes(conf->tree));
+  log_msg(LOG_LEVEL_DEBUG, "statx mask (derived from rule attributes): %#x", conf->statx_mask);
+#endif
+
   if (conf->action&DO_INIT && is_tree_empty(conf->tree)) {
       log_msg(LOG_LEVEL_WARNING, "rule tree is empty, no files will be added to the database");
   }
@@ -871,6 +918,10 @@ int main(int argc,char**argv)
 	exit(IO_ERROR);
     }
 
+    if((conf->action&DO_INIT || conf->action&DO_COMPARE) && conf->hash_cache){
+      hash_cache_open(conf->hash_cache);
+    }
+
     if((conf->action&DO_INIT || conf->action&DO_COMPARE) && conf->num_workers){
       if(db_disk_start_threads()==RETFAIL)
           exit(THREAD_ERROR);
@@ -883,6 +934,15 @@ int main(int argc,char**argv)
           exit(THREAD_ERROR);
     }
 
+    if(conf->action&DO_INIT || conf->action&DO_COMPARE) {
+      log_hardlink_cache_stats();
+      log_small_file_stats();
+      log_hash_cache_stats();
+      /* keep the entries of the files outside the limit */
+      hash_cache_write(conf->limit != NULL);
+      hash_cache_close();
+    }
+
     if(conf->action&DO_INIT) {
         progress_status(PROGRESS_WRITEDB, NULL);
         log_msg(LOG_LEVEL_INFO, "write new entries to database: %s:%s", get_url_type_string((conf->database_out.url)->type), (conf->database_out.url)->value);
@@ -68,6 +68,11 @@ attributes_t attributes[] = {
     { ATTR(attr_stribog512),     "stribog512",   "STRIBOG512",  "stribog512",   "stribog512",   '\0'  },
     { ATTR(attr_growing),        "growing",      NULL,          NULL,           NULL,           '\0'  },
     { ATTR(attr_compressed),     "compressed",   NULL,          NULL,           NULL,           '\0'  },
+    { ATTR(attr_btime),          "btime",        "Btime",       "btime",        "birth_time",   'B'   },
+    { ATTR(attr_blake3),         "blake3",       "BLAKE3",      "blake3",       "blake3",       '\0'  },
+    { ATTR(attr_xxh3),           "xxh3",         "XXH3",        "xxh3",         "xxh3",         '\0'  },
+    { ATTR(attr_crc32c),         "crc32c",       "CRC32C",      "crc32c",       "crc32c",       '\0'  },
+    { ATTR(attr_trustctime),     "trustctime",   NULL,          NULL,           NULL,           '\0'  },
 };
 
 DB_ATTR_TYPE num_attrs = sizeof(attributes)/sizeof(attributes_t);
@@ -57,6 +57,7 @@
 #endif
 #include <math.h>
 #include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 
 #define BUFSIZE 4096
@@ -325,7 +326,7 @@ bool add_rx_rule_to_tree(char* rx, char* rule_prefix, RESTRICTION_TYPE restricti
 
         char *str;
 
-        DB_ATTR_TYPE unsupported_hashes = attr&(get_hashes(true)&~get_hashes(false));
+        DB_ATTR_TYPE unsupported_hashes = attr&(get_hashes(true)&~get_available_hashes());
         if (unsupported_hashes) {
             LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_WARNING, "ignoring unsupported hash algorithm(s): %s", str = diff_attributes(0, unsupported_hashes));
             free(str);
@@ -348,6 +349,9 @@ bool add_rx_rule_to_tree(char* rx, char* rule_prefix, RESTRICTION_TYPE restricti
 #endif
 #ifndef WITH_CAPABILITIES
              |ATTR(attr_capabilities)
+#endif
+#ifndef HAVE_STATX
+             |ATTR(attr_btime)
 #endif
             )
             ;
@@ -361,9 +365,13 @@ bool add_rx_rule_to_tree(char* rx, char* rule_prefix, RESTRICTION_TYPE restricti
         if (attr&ATTR(attr_sizeg)) {
             log_msg(LOG_LEVEL_WARNING, "%s:%d: Using 'S' attribute is DEPRECATED and will be removed in the release after next. Update your config and use 'growing+s' instead (line: '%s')", filename, linenumber, linebuf);
         }
-        if (attr&ATTR(attr_compressed) && !(attr&get_hashes(false))) {
+        if (attr&ATTR(attr_compressed) && !(attr&get_available_hashes())) {
             log_msg(LOG_LEVEL_WARNING, "%s:%d: ignore 'comprressed' attribute (no hashsum attributes are set) (line: '%s')", filename, linenumber, linebuf);
         }
+        DB_ATTR_TYPE trusted_attrs = ATTR(attr_ctime)|ATTR(attr_mtime)|ATTR(attr_size)|ATTR(attr_inode);
+        if (attr&ATTR(attr_trustctime) && (attr&trusted_attrs) != trusted_attrs) {
+            log_msg(LOG_LEVEL_WARNING, "%s:%d: 'trustctime' attribute has no effect without 'c', 'm', 's' and 'i' attributes (line: '%s')", filename, linenumber, linebuf);
+        }
         conf->db_out_attrs |= attr;
 
         LOG_CONFIG_FORMAT_LINE_PREFIX(LOG_LEVEL_CONFIG, "add %s '%s%s %s %s' to node '%s'", get_rule_type_long_string(type), get_rule_type_char(type), r->rx, rs_str = get_restriction_string(r->restriction), attr_str = diff_attributes(0, r->attr), node_path)
@@ -542,6 +550,39 @@ long do_num_workers(const char *str) {
     return number;
 }
 
+/* returns -1 for invalid (or negative) numbers */
+long long do_number(const char *str) {
+    char *err;
+    errno = 0;
+    long long number = strtoll(str,&err,10);
+    if(str[0] == '\0' || *err != '\0' || number < 0 || errno == ERANGE) {
+        return -1;
+    }
+    return number;
+}
+
+/* returns -1 for invalid (or negative) sizes, supports K, M and G suffixes (1024 based) */
+long long do_size(const char *str) {
+    char *err;
+    errno = 0;
+    long long number = strtoll(str,&err,10);
+    if(str[0] == '\0' || number < 0 || errno == ERANGE) {
+        return -1;
+    }
+    int shift = 0;
+    switch (*err) {
+        case '\0': break;
+        case 'k': case 'K': shift = 10; err++; break;
+        case 'm': case 'M': shift = 20; err++; break;
+        case 'g': case 'G': shift = 30; err++; break;
+        default: return -1;
+    }
+    if (*err != '\0' || number > (LLONG_MAX >> shift)) {
+        return -1;
+    }
+    return number << shift;
+}
+
 #ifdef WITH_E2FSATTRS
 void do_report_ignore_e2fsattrs(char* val, int linenumber, char* filename, char* linebuf) {
     conf->report_ignore_e2fsattrs = 0UL;
@@ -58,6 +58,29 @@ config_option_t config_options[] = {
     { REPORT_FORMAT_OPTION,                     NULL,                           NULL },
     { LIMIT_CMDLINE_OPTION,                     "limit",                        "Limit" },
     { NUM_WORKERS,                              NULL,                           NULL },
+    { NUM_SCAN_WORKERS,                         NULL,                           NULL },
+    { NUM_TREE_WORKERS,                         NULL,                           NULL },
+    { SCAN_DIRFD_OPTION,                        NULL,                           NULL },
+    { IO_URING_OPTION,                          NULL,                           NULL },
+    { SCAN_INODE_ORDER_OPTION,                  NULL,                           NULL },
+    { HASH_ORDER_WINDOW_OPTION,                 NULL,                           NULL },
+    { DEVICE_QUEUES_OPTION,                     NULL,                           NULL },
+    { ROTATIONAL_DEVICE_WORKERS_OPTION,         NULL,                           NULL },
+    { NETWORK_DEVICE_WORKERS_OPTION,            NULL,                           NULL },
+    { DEVICE_WORKERS_OPTION,                    NULL,                           NULL },
+    { READ_BLOCK_SIZE_OPTION,                   NULL,                           NULL },
+    { MMAP_THRESHOLD_OPTION,                    NULL,                           NULL },
+    { SMALL_FILE_THRESHOLD_OPTION,              NULL,                           NULL },
+    { SMALL_FILE_INLINE_OPTION,                 NULL,                           NULL },
+    { DIRECT_IO_OPTION,                         NULL,                           NULL },
+    { DROP_PAGE_CACHE_OPTION,                   NULL,                           NULL },
+    { PREFETCH_FILES_OPTION,                    NULL,                           NULL },
+    { PIPELINE_THRESHOLD_OPTION,                NULL,                           NULL },
+    { HASH_THREADS_THRESHOLD_OPTION,            NULL,                           NULL },
+    { NATIVE_HASHSUMS_OPTION,                   NULL,                           NULL },
+    { SMALL_FILE_BATCH_OPTION,                  NULL,                           NULL },
+    { BLAKE3_THREADS_OPTION,                    NULL,                           NULL },
+    { HASH_CACHE_OPTION,                        NULL,                           NULL },
 };
 
 static ast* new_ast_node(void) {
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <limits.h>
 #define PCRE2_CODE_UNIT_WIDTH 8
 #include <pcre2.h>
 #include "attributes.h"
@@ -68,6 +69,28 @@ list* x_include_environment = NULL;
         LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set '%s' to '%s'", #option, btoa(conf->option)) \
         break;
 
+#define NUMBER_CONFIG_OPTION_CASE(id, option) \
+    case id: \
+        str = eval_string_expression(statement.e, linenumber, filename, linebuf); \
+        if ((conf->option = do_number(str)) < 0) { \
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number for '%s' option: '%s'", #option, str) \
+            exit(INVALID_CONFIGURELINE_ERROR); \
+        } \
+        LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set '%s' option to %lld (config value: '%s')", #option, (long long) conf->option, str) \
+        free(str); \
+        break;
+
+#define SIZE_CONFIG_OPTION_CASE(id, option, min, max) \
+    case id: \
+        str = eval_string_expression(statement.e, linenumber, filename, linebuf); \
+        if ((conf->option = do_size(str)) < (min) || conf->option > (max)) { \
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid size for '%s' option: '%s'", #option, str) \
+            exit(INVALID_CONFIGURELINE_ERROR); \
+        } \
+        LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set '%s' option to %lld bytes (config value: '%s')", #option, (long long) conf->option, str) \
+        free(str); \
+        break;
+
 #define ATTRIBUTE_CONFIG_OPTION_CASE(id, option) \
     case id: \
         attr = eval_attribute_expression(statement.a, linenumber, filename, linebuf); \
@@ -175,7 +198,7 @@ static void set_database_attr_option(DB_ATTR_TYPE attr, int linenumber, char *fi
             free(str);
             exit(INVALID_CONFIGURELINE_ERROR);
         }
-        DB_ATTR_TYPE unsupported_hashes = attr&(get_hashes(true)&~get_hashes(false));
+        DB_ATTR_TYPE unsupported_hashes = attr&(get_hashes(true)&~get_available_hashes());
         if (unsupported_hashes) {
             LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_WARNING, "ignoring unsupported hash algorithm(s): %s", str = diff_attributes(0, unsupported_hashes));
             free(str);
@@ -253,6 +276,26 @@ static void eval_config_statement(config_option_statement statement, int linenum
         BOOL_CONFIG_OPTION_CASE(REPORT_APPEND_OPTION, report_append)
         BOOL_CONFIG_OPTION_CASE(REPORT_SUMMARIZE_CHANGES_OPTION, report_summarize_changes)
         BOOL_CONFIG_OPTION_CASE(WARN_DEAD_SYMLINKS_OPTION, warn_dead_symlinks)
+        BOOL_CONFIG_OPTION_CASE(SCAN_DIRFD_OPTION, scan_dirfd)
+        BOOL_CONFIG_OPTION_CASE(IO_URING_OPTION, io_uring)
+        BOOL_CONFIG_OPTION_CASE(SCAN_INODE_ORDER_OPTION, scan_inode_order)
+        NUMBER_CONFIG_OPTION_CASE(HASH_ORDER_WINDOW_OPTION, hash_order_window)
+        BOOL_CONFIG_OPTION_CASE(DEVICE_QUEUES_OPTION, device_queues)
+        NUMBER_CONFIG_OPTION_CASE(ROTATIONAL_DEVICE_WORKERS_OPTION, rotational_device_workers)
+        NUMBER_CONFIG_OPTION_CASE(NETWORK_DEVICE_WORKERS_OPTION, network_device_workers)
+        NUMBER_CONFIG_OPTION_CASE(DEVICE_WORKERS_OPTION, device_workers)
+        SIZE_CONFIG_OPTION_CASE(READ_BLOCK_SIZE_OPTION, read_block_size, 1, SSIZE_MAX)
+        SIZE_CONFIG_OPTION_CASE(MMAP_THRESHOLD_OPTION, mmap_threshold, 0, LLONG_MAX)
+        SIZE_CONFIG_OPTION_CASE(SMALL_FILE_THRESHOLD_OPTION, small_file_threshold, 0, LLONG_MAX)
+        BOOL_CONFIG_OPTION_CASE(SMALL_FILE_INLINE_OPTION, small_file_inline)
+        BOOL_CONFIG_OPTION_CASE(DIRECT_IO_OPTION, direct_io)
+        BOOL_CONFIG_OPTION_CASE(DROP_PAGE_CACHE_OPTION, drop_page_cache)
+        NUMBER_CONFIG_OPTION_CASE(PREFETCH_FILES_OPTION, prefetch_files)
+        SIZE_CONFIG_OPTION_CASE(PIPELINE_THRESHOLD_OPTION, pipeline_threshold, 0, LLONG_MAX)
+        SIZE_CONFIG_OPTION_CASE(HASH_THREADS_THRESHOLD_OPTION, hash_threads_threshold, 0, LLONG_MAX)
+        BOOL_CONFIG_OPTION_CASE(NATIVE_HASHSUMS_OPTION, native_hashsums)
+        NUMBER_CONFIG_OPTION_CASE(SMALL_FILE_BATCH_OPTION, small_file_batch)
+        NUMBER_CONFIG_OPTION_CASE(BLAKE3_THREADS_OPTION, blake3_threads)
         BOOL_CONFIG_OPTION_CASE(CONFIG_CHECK_WARN_UNRESTRICTED_RULES, config_check_warn_unrestricted_rules)
         case REPORT_LEVEL_OPTION:
             str = eval_string_expression(statement.e, linenumber, filename, linebuf);
@@ -293,6 +336,12 @@ static void eval_config_statement(config_option_statement statement, int linenum
             }
             free(str);
             break;
+        case HASH_CACHE_OPTION:
+            /* not to be freed, used directly for hash_cache */
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            conf->hash_cache = str;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'hash_cache' option to '%s'", str)
+            break;
         case CONFIG_VERSION:
             /* not to be freed, used directly for config_version */
             str = eval_string_expression(statement.e, linenumber, filename, linebuf);
@@ -317,6 +366,36 @@ static void eval_config_statement(config_option_statement statement, int linenum
                     LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "'num_workers' option already set (ignore new value '%s')", str)
             }
             break;
+        case NUM_SCAN_WORKERS:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+
+            if (conf->num_scan_workers < 0) {
+                long num_scan_workers = do_num_workers(str);
+                if (num_scan_workers < 0) {
+                    LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of scan workers: '%s'", str);
+                    exit(INVALID_CONFIGURELINE_ERROR);
+                }
+                conf->num_scan_workers = num_scan_workers;
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'num_scan_workers' option to %ld (config value: '%s')", conf->num_scan_workers, str)
+            } else {
+                    LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "'num_scan_workers' option already set (ignore new value '%s')", str)
+            }
+            break;
+        case NUM_TREE_WORKERS:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+
+            if (conf->num_tree_workers < 0) {
+                long num_tree_workers = do_num_workers(str);
+                if (num_tree_workers < 1) {
+                    LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of tree workers: '%s'", str);
+                    exit(INVALID_CONFIGURELINE_ERROR);
+                }
+                conf->num_tree_workers = num_tree_workers;
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'num_tree_workers' option to %ld (config value: '%s')", conf->num_tree_workers, str)
+            } else {
+                    LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "'num_tree_workers' option already set (ignore new value '%s')", str)
+            }
+            break;
     }
 }
 
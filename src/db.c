@@ -221,6 +221,7 @@ db_line* db_char2line(char** ss, database* db){
   line->atime=0;
   line->ctime=0;
   line->mtime=0;
+  line->btime=0;
   line->inode=0;
   line->nlink=0;
   line->bcount=0;
@@ -281,6 +282,10 @@ db_line* db_char2line(char** ss, database* db){
       line->ctime=base64totime_t(ss[db->fields[i]], db, "ctime");
       break;
     }
+    case attr_btime : {
+      line->btime=base64totime_t(ss[db->fields[i]], db, "btime");
+      break;
+    }
     case attr_inode : {
       line->inode=readlong(ss[db->fields[i]], db, "inode");
       break;
@@ -311,6 +316,9 @@ db_line* db_char2line(char** ss, database* db){
     CHAR2HASH(gostr3411_94)
     CHAR2HASH(stribog256)
     CHAR2HASH(stribog512)
+    CHAR2HASH(blake3)
+    CHAR2HASH(xxh3)
+    CHAR2HASH(crc32c)
     case attr_acl : {
 #ifdef WITH_POSIX_ACL
       char *tval = NULL;
@@ -412,6 +420,7 @@ db_line* db_char2line(char** ss, database* db){
     case attr_checkinode :
     case attr_allhashsums :
     case attr_growing :
+    case attr_trustctime :
     case attr_compressed :
     case attr_allownewfile :
     case attr_allowrmfile : {
@@ -25,39 +25,73 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 #include <stdlib.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#ifdef HAVE_SYS_SYSMACROS_H
+#include <sys/sysmacros.h>
+#endif
+#ifdef HAVE_SYS_VFS_H
+#include <sys/vfs.h>
+#endif
+#ifdef HAVE_LINUX_FIEMAP_H
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#endif
 #include <errno.h>
 #include <stdbool.h>
 #include "db_config.h"
 #include "log.h"
 #include "rx_rule.h"
 #include "gen_list.h"
+#include "hash_cache.h"
+#include "do_md.h"
 #include "db.h"
 #include "db_line.h"
 #include "db_disk.h"
 #include "util.h"
 #include "queue.h"
+#include "ring.h"
 #include "errorcodes.h"
+#ifdef WITH_URING
+#include "uring.h"
+#endif
 
 #include <pthread.h>
 
-static int get_file_status(char *filename, struct stat *fs) {
+/*
+ * If dir_fd is not -1 the status of name is read relative to the directory
+ * file descriptor (filename is only used for logging), otherwise filename
+ * is lstat'ed. btime is set to the birth time (see stat_masked).
+ */
+static int get_file_status(int dir_fd, const char *name, char *filename, struct stat *fs, time_t *btime) {
     int sres = 0;
-    sres = lstat(filename,fs);
+    const char *func = dir_fd == -1 ? "lstat" : "fstatat";
+    sres = dir_fd == -1 ? stat_masked(AT_FDCWD, filename, fs, btime, AT_SYMLINK_NOFOLLOW) : stat_masked(dir_fd, name, fs, btime, AT_SYMLINK_NOFOLLOW);
     if(sres == -1){
         char* er = strerror(errno);
         if (er == NULL) {
-            log_msg(LOG_LEVEL_WARNING, "get_file_status: lstat() failed for %s. strerror() failed with %i", filename, errno);
+            log_msg(LOG_LEVEL_WARNING, "get_file_status: %s() failed for %s. strerror() failed with %i", func, filename, errno);
         } else {
-            log_msg(LOG_LEVEL_WARNING, "get_file_status: lstat() failed for %s: %s", filename, er);
+            log_msg(LOG_LEVEL_WARNING, "get_file_status: %s() failed for %s: %s", func, filename, er);
         }
     }
     return sres;
 }
 
-queue_ts_t *queue_worker_files = NULL;
-queue_ts_t *queue_database_entries = NULL;
+/* number of slots of the bounded worker files and database entries queues per worker */
+#define QUEUE_SLOTS_PER_WORKER 256
+
+/* maximum number of database entries added to the tree at once */
+#define ADD2TREE_BATCH_SIZE 64
+
+ring_ts_t *queue_worker_files = NULL;
+/* one queue per add2tree thread (see num_tree_workers) */
+ring_ts_t **queue_database_entries = NULL;
 
 pthread_t wait_for_workers_thread = 0;
 
@@ -65,19 +99,115 @@ pthread_t *file_attributes_threads = 0;
 
 const char *whoami_main = "(main)";
 
-static char *name_construct (const char *dirpath, const char *filename) {
-    int dirpath_len = strlen (dirpath);
-    int len = dirpath_len + strlen(filename) + (dirpath[dirpath_len-1] != '/'?1:0) + 1;
-    char *ret = checked_malloc(len);
-    snprintf(ret, len, "%s%s%s", dirpath, dirpath[dirpath_len-1] != '/'?"/":"", filename);
-    log_msg(LOG_LEVEL_TRACE,"name_construct: dir: '%s' (%p) + filename: '%s' (%p): '%s' (%p)", dirpath, (void*) dirpath, filename, (void*) filename, ret, (void*) ret);
-    return ret;
+/*
+ * Open directory handle shared by the queued child directories
+ * (used if 'scan_dirfd' is enabled)
+ */
+typedef struct scan_dir_handle {
+    DIR *dir;
+    int refs;
+} scan_dir_handle;
+
+typedef struct scan_dir_item {
+    char *full_path;
+    const char *name; /* last path component of full_path */
+    scan_dir_handle *parent; /* NULL if full_path has to be opened directly */
+} scan_dir_item;
+
+static pthread_mutex_t scan_handle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static long scan_open_handles = 0;
+static long scan_max_open_handles = 0;
+
+static scan_dir_item *scan_dir_item_new(char *full_path, size_t name_offset, scan_dir_handle *parent) {
+    scan_dir_item *item = checked_malloc(sizeof(scan_dir_item)); /* freed in scan_dir_item_free */
+    item->full_path = full_path;
+    item->name = &full_path[name_offset];
+    item->parent = parent;
+    return item;
+}
+
+static scan_dir_handle *scan_dir_handle_new(DIR *dir) {
+    scan_dir_handle *handle = NULL;
+    pthread_mutex_lock(&scan_handle_mutex);
+    if (scan_open_handles < scan_max_open_handles) {
+        handle = checked_malloc(sizeof(scan_dir_handle)); /* freed in scan_dir_handle_release */
+        handle->dir = dir;
+        handle->refs = 1;
+        scan_open_handles++;
+    }
+    pthread_mutex_unlock(&scan_handle_mutex);
+    return handle;
+}
+
+static scan_dir_handle *scan_dir_handle_ref(scan_dir_handle *handle) {
+    if (handle) {
+        pthread_mutex_lock(&scan_handle_mutex);
+        handle->refs++;
+        pthread_mutex_unlock(&scan_handle_mutex);
+    }
+    return handle;
+}
+
+static void scan_dir_handle_release(scan_dir_handle *handle) {
+    if (handle) {
+        pthread_mutex_lock(&scan_handle_mutex);
+        if (--handle->refs == 0) {
+            closedir(handle->dir);
+            scan_open_handles--;
+            free(handle);
+        }
+        pthread_mutex_unlock(&scan_handle_mutex);
+    }
+}
+
+static void scan_dir_item_free(scan_dir_item *item) {
+    scan_dir_handle_release(item->parent);
+    free(item->full_path);
+    free(item);
+}
+
+static long scan_dir_get_max_open_handles(void) {
+    struct rlimit rl;
+    /* leave half of the file descriptors to the hashing of the files */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+        return rl.rlim_cur/2;
+    }
+    return 512;
+}
+
+static DIR *scan_dir_open(scan_dir_item *item) {
+    if (conf->scan_dirfd) {
+        int fd;
+        if (item->parent) {
+            fd = openat(dirfd(item->parent->dir), item->name, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        } else {
+            fd = open(item->full_path, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+        }
+        /* the parent directory is no longer needed by this item (closing it must not clobber errno) */
+        int saved_errno = errno;
+        scan_dir_handle_release(item->parent);
+        item->parent = NULL;
+        if (fd == -1) {
+            errno = saved_errno;
+            return NULL;
+        }
+        DIR *dir = fdopendir(fd);
+        if (dir == NULL) {
+            saved_errno = errno;
+            close(fd);
+            errno = saved_errno;
+        }
+        return dir;
+    } else {
+        return opendir(item->full_path);
+    }
 }
 
 typedef struct scan_dir_entry {
     char *filename;
     DB_ATTR_TYPE attr;
     struct stat fs;
+    time_t btime;
 } scan_dir_entry;
 
 typedef struct database_entry {
@@ -85,7 +215,337 @@ typedef struct database_entry {
     struct stat fs;
 } database_entry;
 
-static void handle_matched_file(char *entry_full_path, DB_ATTR_TYPE attr, struct stat fs) {
+/*
+ * Per-device worker queues
+ *
+ * If 'device_queues' is enabled, the files are queued per device and every
+ * device is only processed by a limited number of workers at once
+ * ('rotational_device_workers' for rotational disks, 'network_device_workers'
+ * for network file systems and 'device_workers' for all other devices).
+ * Every device queue holds at most QUEUE_SLOTS_PER_WORKER files per worker
+ * of the device, the scanner waits while the queue of a device is full.
+ */
+
+typedef enum device_type {
+    DEVICE_TYPE_OTHER,
+    DEVICE_TYPE_ROTATIONAL,
+    DEVICE_TYPE_NETWORK,
+} device_type;
+
+static const char *device_type_names[] = { "other", "rotational", "network" };
+
+typedef struct device_queue {
+    dev_t dev;
+    long limit;
+    long active;
+    ring_ts_t *files;
+    long pending;
+} device_queue;
+
+static pthread_mutex_t device_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* signaled if a file has been queued or a worker is done */
+static pthread_cond_t device_cond = PTHREAD_COND_INITIALIZER;
+/* signaled if a file has been taken from a device queue */
+static pthread_cond_t device_not_full_cond = PTHREAD_COND_INITIALIZER;
+static device_queue *device_queues = NULL;
+static long num_device_queues = 0;
+static long device_next = 0;
+static bool device_release = false;
+
+static bool is_network_filesystem(__attribute__((unused)) const char *filename) {
+#ifdef HAVE_SYS_VFS_H
+    /* see statfs(2) */
+    static const long network_magics[] = {
+        0x6969, /* NFS */
+        0x517b, /* SMB */
+        0xfe534d42, /* SMB2 */
+        0xff534d42, /* CIFS */
+        0x00c36400, /* CEPH */
+        0x01021997, /* V9FS */
+        0x5346414f, /* AFS */
+        0x73757245, /* CODA */
+    };
+    struct statfs sfs;
+    if (filename && statfs(filename, &sfs) == 0) {
+        for (size_t i = 0 ; i < sizeof(network_magics)/sizeof(long) ; ++i) {
+            if ((unsigned long) sfs.f_type == (unsigned long) network_magics[i]) {
+                return true;
+            }
+        }
+    }
+#endif
+    return false;
+}
+
+static bool is_rotational_device(__attribute__((unused)) dev_t dev) {
+    bool rotational = false;
+#ifdef HAVE_SYS_SYSMACROS_H
+    /* partitions have no queue directory, use the one of the parent disk */
+    const char *formats[] = { "/sys/dev/block/%u:%u/queue/rotational", "/sys/dev/block/%u:%u/../queue/rotational" };
+    for (size_t i = 0 ; i < sizeof(formats)/sizeof(char*) ; ++i) {
+        char path[64];
+        snprintf(path, sizeof(path), formats[i], major(dev), minor(dev));
+        FILE *fp = fopen(path, "r");
+        if (fp) {
+            int c = fgetc(fp);
+            fclose(fp);
+            rotational = (c == '1');
+            break;
+        }
+    }
+#endif
+    return rotational;
+}
+
+/*
+ * device_mutex has to be locked, filename (a file on the device) is only used
+ * to detect network file systems if a new queue is created
+ *
+ * the returned pointer is only valid as long as device_mutex is locked
+ */
+static device_queue *get_device_queue(dev_t dev, const char *filename) {
+    for (long i = 0 ; i < num_device_queues ; ++i) {
+        if (device_queues[i].dev == dev) {
+            return &device_queues[i];
+        }
+    }
+    device_queues = checked_realloc(device_queues, (num_device_queues+1)*sizeof(device_queue)); /* freed in wait_for_workers */
+    device_queue *queue = &device_queues[num_device_queues++];
+    device_type type = is_network_filesystem(filename) ? DEVICE_TYPE_NETWORK
+                     : is_rotational_device(dev) ? DEVICE_TYPE_ROTATIONAL : DEVICE_TYPE_OTHER;
+    long limit = 0;
+    switch (type) {
+        case DEVICE_TYPE_ROTATIONAL:
+            limit = conf->rotational_device_workers;
+            break;
+        case DEVICE_TYPE_NETWORK:
+            limit = conf->network_device_workers;
+            break;
+        case DEVICE_TYPE_OTHER:
+            limit = conf->device_workers;
+            break;
+    }
+    queue->dev = dev;
+    queue->limit = limit > 0 && limit < conf->num_workers ? limit : conf->num_workers;
+    queue->active = 0;
+    queue->files = ring_ts_init(queue->limit * QUEUE_SLOTS_PER_WORKER); /* freed in wait_for_workers */
+    queue->pending = 0;
+    log_msg(LOG_LEVEL_DEBUG, "new device queue for device %#lx (type: %s, max. workers: %ld, capacity: %zu)", (unsigned long) dev,
+            device_type_names[type], queue->limit, ring_ts_capacity(queue->files));
+    return queue;
+}
+
+static void process_worker_file(scan_dir_entry *, md_hashsums *, const char *);
+
+static void worker_files_enqueue(scan_dir_entry *data, const char *whoami) {
+    if (conf->device_queues) {
+        pthread_mutex_lock(&device_mutex);
+        device_queue *queue;
+        while (!ring_ts_try_enqueue((queue = get_device_queue(data->fs.st_dev, data->filename))->files, data)) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: device queue %#lx is full, wait for free slot", whoami, (unsigned long) data->fs.st_dev);
+            pthread_cond_wait(&device_not_full_cond, &device_mutex);
+        }
+        queue->pending++;
+        pthread_cond_signal(&device_cond);
+        pthread_mutex_unlock(&device_mutex);
+        log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: add entry %p to device queue %#lx (filename: '%s')", whoami, (void*) data, (unsigned long) data->fs.st_dev, data->filename);
+    } else if (conf->small_file_inline && is_small_file(&data->fs) && (data->attr&get_available_hashes())) {
+        if (!ring_ts_try_enqueue(queue_worker_files, data)) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: worker files queue is full, process small file '%s' inline", whoami, data->filename);
+            process_worker_file(data, NULL, whoami);
+        }
+    } else {
+        ring_ts_enqueue(queue_worker_files, data, whoami);
+    }
+}
+
+/* returns NULL if no file is left (or if wait is false and no file is currently available) */
+static scan_dir_entry *worker_files_dequeue(bool wait, const char *whoami) {
+    if (conf->device_queues) {
+        scan_dir_entry *data = NULL;
+        pthread_mutex_lock(&device_mutex);
+        while (1) {
+            bool pending = false;
+            for (long i = 0 ; i < num_device_queues ; ++i) {
+                device_queue *queue = &device_queues[(device_next+i)%num_device_queues];
+                if (queue->pending) {
+                    pending = true;
+                    if (queue->active < queue->limit) {
+                        data = ring_ts_dequeue(queue->files, whoami);
+                        queue->pending--;
+                        queue->active++;
+                        device_next = (device_next+i+1)%num_device_queues;
+                        pthread_cond_broadcast(&device_not_full_cond);
+                        break;
+                    }
+                }
+            }
+            if (data || !wait || (device_release && !pending)) {
+                break;
+            }
+            log_msg(LOG_LEVEL_THREAD, "%10s: queue: wait for files of idle devices", whoami);
+            pthread_cond_wait(&device_cond, &device_mutex);
+        }
+        pthread_mutex_unlock(&device_mutex);
+        return data;
+    } else {
+        return wait ? ring_ts_dequeue_wait(queue_worker_files, whoami) : ring_ts_dequeue(queue_worker_files, whoami);
+    }
+}
+
+/* waits for the first file only, returns 0 if no file is left */
+static size_t worker_files_dequeue_batch(scan_dir_entry **data, size_t n, const char *whoami) {
+    if (conf->device_queues) {
+        size_t i = 0;
+        if (n && (data[i] = worker_files_dequeue(true, whoami)) != NULL) {
+            ++i;
+            while (i < n && (data[i] = worker_files_dequeue(false, whoami)) != NULL) {
+                ++i;
+            }
+        }
+        return i;
+    } else {
+        return ring_ts_dequeue_batch_wait(queue_worker_files, (void **) data, n, whoami);
+    }
+}
+
+static void worker_files_done(dev_t dev) {
+    if (conf->device_queues) {
+        pthread_mutex_lock(&device_mutex);
+        get_device_queue(dev, NULL)->active--;
+        pthread_cond_broadcast(&device_cond);
+        pthread_mutex_unlock(&device_mutex);
+    }
+}
+
+/* returns true if the hashsums can be taken from the old database or the hash cache */
+static bool has_known_hashsums(scan_dir_entry *data) {
+    return get_carried_over_hashsums(data->filename, data->attr, &data->fs, NULL)
+        || get_cached_hashsums(data->filename, data->attr, &data->fs, NULL);
+}
+
+/*
+ * Hash order window
+ *
+ * Files to be hashed are collected in a window of 'hash_order_window' files
+ * which is handed over to the workers sorted by the physical offset of the
+ * first extent of the files (falls back to inode order if the offset is
+ * not available). Files with known hashsums (see has_known_hashsums) are
+ * not read and therefore not ordered.
+ */
+
+typedef struct hash_order_entry {
+    scan_dir_entry *data;
+    bool physical;
+    unsigned long long key;
+} hash_order_entry;
+
+static pthread_mutex_t hash_order_mutex = PTHREAD_MUTEX_INITIALIZER;
+static hash_order_entry *hash_order_window = NULL;
+static long hash_order_count = 0;
+
+/* returns false if the physical offset is not available */
+static bool get_physical_offset(__attribute__((unused)) const char *filename, __attribute__((unused)) unsigned long long *offset) {
+    bool found = false;
+#ifdef HAVE_LINUX_FIEMAP_H
+    int fd = open(filename, O_RDONLY|O_NOFOLLOW|O_NONBLOCK|O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    union {
+        struct fiemap fm;
+        char buf[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    } u;
+    memset(&u, 0, sizeof(u));
+    u.fm.fm_start = 0;
+    u.fm.fm_length = FIEMAP_MAX_OFFSET;
+    u.fm.fm_extent_count = 1;
+    if (ioctl(fd, FS_IOC_FIEMAP, &u.fm) == 0 && u.fm.fm_mapped_extents > 0
+            && !(u.fm.fm_extents[0].fe_flags&(FIEMAP_EXTENT_UNKNOWN|FIEMAP_EXTENT_DELALLOC|FIEMAP_EXTENT_DATA_INLINE))) {
+        *offset = u.fm.fm_extents[0].fe_physical;
+        found = true;
+    }
+    close(fd);
+#endif
+    return found;
+}
+
+static int hash_order_cmp(const void *a, const void *b) {
+    const hash_order_entry *x = a;
+    const hash_order_entry *y = b;
+    if (x->data->fs.st_dev != y->data->fs.st_dev) {
+        return x->data->fs.st_dev < y->data->fs.st_dev ? -1 : 1;
+    }
+    if (x->physical != y->physical) {
+        return x->physical ? -1 : 1;
+    }
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+/*
+ * hash_order_mutex has to be locked, the window is taken over by the caller
+ * (see hash_order_flush) and replaced by a new one on the next add
+ */
+static hash_order_entry *hash_order_take_window(long *count) {
+    hash_order_entry *window = hash_order_window;
+    *count = hash_order_count;
+    hash_order_window = NULL;
+    hash_order_count = 0;
+    return window;
+}
+
+/* hash_order_mutex must not be locked as enqueuing may block */
+static void hash_order_flush(hash_order_entry *window, long count, const char *whoami) {
+    if (count) {
+        log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: hand over %ld ordered files to the workers", whoami, count);
+        qsort(window, count, sizeof(hash_order_entry), &hash_order_cmp);
+        for (long i = 0 ; i < count ; ++i) {
+            worker_files_enqueue(window[i].data, whoami);
+        }
+    }
+    free(window);
+}
+
+static void hash_order_add(scan_dir_entry *data, const char *whoami) {
+    hash_order_entry entry = { data, false, data->fs.st_ino };
+    if (get_physical_offset(data->filename, &entry.key)) {
+        entry.physical = true;
+    }
+    log_msg(LOG_LEVEL_TRACE, "scan_dir: add '%s' to hash order window (%s: %llu)", data->filename, entry.physical?"physical offset":"inode", entry.key);
+
+    hash_order_entry *window = NULL;
+    long count = 0;
+    pthread_mutex_lock(&hash_order_mutex);
+    if (hash_order_window == NULL) {
+        hash_order_window = checked_malloc(conf->hash_order_window*sizeof(hash_order_entry)); /* freed in hash_order_flush */
+    }
+    hash_order_window[hash_order_count++] = entry;
+    if (hash_order_count == conf->hash_order_window) {
+        window = hash_order_take_window(&count);
+    }
+    pthread_mutex_unlock(&hash_order_mutex);
+    if (window) {
+        hash_order_flush(window, count, whoami);
+    }
+}
+
+static void release_worker_files(const char *whoami) {
+    long count;
+    pthread_mutex_lock(&hash_order_mutex);
+    hash_order_entry *window = hash_order_take_window(&count);
+    pthread_mutex_unlock(&hash_order_mutex);
+    hash_order_flush(window, count, whoami);
+    if (conf->device_queues) {
+        pthread_mutex_lock(&device_mutex);
+        device_release = true;
+        pthread_cond_broadcast(&device_cond);
+        pthread_mutex_unlock(&device_mutex);
+    } else {
+        ring_ts_release(queue_worker_files, whoami);
+    }
+}
+
+static void handle_matched_file(char *entry_full_path, DB_ATTR_TYPE attr, struct stat fs, time_t btime, const char *whoami) {
     char *filename = checked_strdup(entry_full_path); /* not te be freed, reused as fullname in db_line */;
     if (conf->num_workers) {
         scan_dir_entry *data;
@@ -93,130 +553,511 @@ static void handle_matched_file(char *entry_full_path, DB_ATTR_TYPE attr, struct
         data->filename = filename;
         data->attr = attr;
         data->fs = fs;
-        log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: add entry %p to list of worker files (filename: '%s' (%p))", whoami_main,  (void*) data, data->filename, (void*) data->filename);
-        queue_ts_enqueue(queue_worker_files, data, whoami_main);
+        data->btime = btime;
+        if (conf->hash_order_window > 1 && attr&get_hashes(true) && S_ISREG(fs.st_mode) && !has_known_hashsums(data)) {
+            hash_order_add(data, whoami);
+            return;
+        }
+        log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: add entry %p to list of worker files (filename: '%s' (%p))", whoami,  (void*) data, data->filename, (void*) data->filename);
+        worker_files_enqueue(data, whoami);
     } else {
-        db_line *line = get_file_attrs(filename, attr, &fs);
+        db_line *line = get_file_attrs(filename, attr, &fs, btime, NULL);
         add_file_to_tree(conf->tree, line, DB_NEW|DB_DISK, NULL, &fs);
     }
 }
 
+/*
+ * Handles a single directory entry and returns true if the entry is a
+ * directory which has to be added to the scan stack.
+ *
+ * fs and btime are only used for selective/equal matches (if not dry_run).
+ */
+static bool scan_dir_process_entry(char *entry_full_path, match_t path_match, RESTRICTION_TYPE restriction, struct stat *fs, time_t btime, bool dry_run, const char *whoami) {
+    LOG_LEVEL log_level = LOG_LEVEL_TRACE;
+    bool add_to_stack = false;
+    switch (path_match.result) {
+        case RESULT_SELECTIVE_MATCH:
+        case RESULT_EQUAL_MATCH:
+            if (restriction == FT_DIR) {
+                log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: selective/equal match)", &entry_full_path[conf->root_prefix_length]);
+                add_to_stack = true;
+            }
+            if (!dry_run) {
+                handle_matched_file(entry_full_path, path_match.rule->attr, *fs, btime, whoami);
+            }
+            break;
+        case RESULT_PARTIAL_MATCH:
+            if (restriction == FT_DIR) {
+                log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: partial match)", &entry_full_path[conf->root_prefix_length]);
+                add_to_stack = true;
+            }
+            break;
+        case RESULT_RECURSIVE_NEGATIVE_MATCH:
+            if (restriction == FT_DIR) {
+                log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: recursive negative match)", &entry_full_path[conf->root_prefix_length]);
+                add_to_stack = true;
+            }
+            break;
+        case RESULT_PARTIAL_LIMIT_MATCH:
+            if(restriction == FT_DIR) {
+                log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: partial limit match)", &entry_full_path[conf->root_prefix_length]);
+                add_to_stack = true;
+            }
+            break;
+        case RESULT_NON_RECURSIVE_NEGATIVE_MATCH:
+            if(restriction == FT_DIR) {
+                log_msg(log_level, "scan_dir: do NOT add child directory '%s' to scan stack (reason: non-recursive negative match)", &entry_full_path[conf->root_prefix_length]);
+            }
+            break;
+        case RESULT_NEGATIVE_PARENT_MATCH:
+        case RESULT_NO_RULE_MATCH:
+        case RESULT_NO_LIMIT_MATCH:
+        case RESULT_PART_LIMIT_AND_NO_RECURSE_MATCH:
+            break;
+    }
+    if (dry_run) {
+        print_match(&entry_full_path[conf->root_prefix_length], path_match, restriction);
+    }
+    return add_to_stack;
+}
+
+#ifndef DT_UNKNOWN
+#define DT_UNKNOWN 0
+#endif
+#ifndef DTTOIF
+#define DTTOIF(dirtype) ((dirtype) << 12)
+#endif
+
+typedef struct scan_dir_context {
+    char *entry_full_path;
+    size_t name_offset;
+    int dir_fd;
+    scan_dir_handle *handle;
+    bool dry_run;
+    const char *whoami;
+    void (*add_dir)(scan_dir_item *, void *);
+    void *arg;
+} scan_dir_context;
+
+/* d_type is DT_UNKNOWN if the file type of the entry is not known */
+static void scan_dir_read_entry(scan_dir_context *ctx, const char *name, unsigned char d_type) {
+    struct stat fs;
+    time_t btime = 0;
+    char *entry_full_path = ctx->entry_full_path;
+    RESTRICTION_TYPE restriction;
+    match_t path_match;
+
+    strcpy(&entry_full_path[ctx->name_offset], name);
+    log_msg(LOG_LEVEL_TRACE, "scan_dir: process child directory '%s' (fullpath: '%s')", &entry_full_path[conf->root_prefix_length], entry_full_path);
+    if (d_type != DT_UNKNOWN) {
+        /* provisional match using the file type of the directory entry */
+        restriction = get_restriction_from_perm(DTTOIF(d_type));
+        path_match = check_rxtree (&entry_full_path[conf->root_prefix_length], conf->tree, restriction, "disk", false);
+        if (ctx->dry_run || !(path_match.result&(RESULT_EQUAL_MATCH|RESULT_SELECTIVE_MATCH))) {
+            log_msg(LOG_LEVEL_TRACE, "scan_dir: skip file status of '%s' (not added)", &entry_full_path[conf->root_prefix_length]);
+        } else if (get_file_status(ctx->dir_fd, name, entry_full_path, &fs, &btime)) {
+            return;
+        } else if (get_restriction_from_perm(fs.st_mode) != restriction) {
+            log_msg(LOG_LEVEL_DEBUG, "scan_dir: file type of '%s' changed since reading the directory", &entry_full_path[conf->root_prefix_length]);
+            restriction = get_restriction_from_perm(fs.st_mode);
+            path_match = check_rxtree (&entry_full_path[conf->root_prefix_length], conf->tree, restriction, "disk", false);
+        }
+    } else {
+        if (get_file_status(ctx->dir_fd, name, entry_full_path, &fs, &btime)) {
+            return;
+        }
+        restriction = get_restriction_from_perm(fs.st_mode);
+        path_match = check_rxtree (&entry_full_path[conf->root_prefix_length], conf->tree, restriction, "disk", false);
+    }
+    if (scan_dir_process_entry(entry_full_path, path_match, restriction, &fs, btime, ctx->dry_run, ctx->whoami)) {
+        ctx->add_dir(scan_dir_item_new(checked_strdup(entry_full_path), ctx->name_offset, scan_dir_handle_ref(ctx->handle)), ctx->arg);
+    }
+}
+
+static unsigned char scan_dir_get_d_type(__attribute__((unused)) struct dirent *entp) {
+#ifdef _DIRENT_HAVE_D_TYPE
+    return entp->d_type;
+#else
+    return DT_UNKNOWN;
+#endif
+}
+
+typedef struct scan_dir_ino_entry {
+    ino_t ino;
+    unsigned char d_type;
+    size_t name; /* offset in the names buffer */
+} scan_dir_ino_entry;
+
+static int scan_dir_ino_cmp(const void *a, const void *b) {
+    ino_t x = ((const scan_dir_ino_entry*) a)->ino;
+    ino_t y = ((const scan_dir_ino_entry*) b)->ino;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Reads all entries of the directory and processes them in inode order
+ * to avoid random seeks in the inode table
+ */
+static void scan_dir_read_entries_by_inode(scan_dir_context *ctx, DIR *dir) {
+    struct dirent *entp;
+    scan_dir_ino_entry *entries = NULL;
+    char *names = NULL;
+    size_t num_entries = 0, entries_size = 0, names_length = 0, names_size = 0;
+
+    while ((entp = readdir(dir)) != NULL) {
+        if (strcmp(entp->d_name, ".") != 0 && strcmp(entp->d_name, "..") != 0) {
+            size_t len = strlen(entp->d_name) + 1;
+            if (num_entries == entries_size) {
+                entries_size = entries_size?2*entries_size:64;
+                entries = checked_realloc(entries, entries_size*sizeof(scan_dir_ino_entry)); /* freed below */
+            }
+            if (names_length + len > names_size) {
+                names_size = 2*(names_size + len);
+                names = checked_realloc(names, names_size); /* freed below */
+            }
+            memcpy(&names[names_length], entp->d_name, len);
+            entries[num_entries++] = (scan_dir_ino_entry) { entp->d_ino, scan_dir_get_d_type(entp), names_length };
+            names_length += len;
+        }
+    }
+    qsort(entries, num_entries, sizeof(scan_dir_ino_entry), &scan_dir_ino_cmp);
+    for (size_t i = 0 ; i < num_entries ; ++i) {
+        scan_dir_read_entry(ctx, &names[entries[i].name], entries[i].d_type);
+    }
+    free(entries);
+    free(names);
+}
+
+/*
+ * Reads the directory of item and calls add_dir for every child directory
+ * to be scanned (the callback takes over the allocated item).
+ *
+ * The entry paths are constructed in a buffer reused for all entries of the
+ * directory, they are only copied for matched files and child directories.
+ */
+static void scan_dir_read_directory(scan_dir_item *item, bool dry_run, const char *whoami, void (*add_dir)(scan_dir_item *, void *), void *arg) {
+    DIR *dir;
+    char *full_path = item->full_path;
+    char *file_path = &full_path[conf->root_prefix_length];
+    log_msg(LOG_LEVEL_DEBUG,"scan_dir: process directory '%s' (fullpath: '%s')", file_path, full_path);
+    if((dir = scan_dir_open(item)) == NULL) {
+        log_msg(LOG_LEVEL_WARNING,"opendir() failed for '%s' (fullpath: '%s'): %s", file_path, full_path, strerror(errno));
+    } else {
+        struct dirent *entp;
+        scan_dir_context ctx = {
+            .handle = conf->scan_dirfd ? scan_dir_handle_new(dir) : NULL,
+            .dir_fd = conf->scan_dirfd ? dirfd(dir) : -1,
+            .dry_run = dry_run,
+            .whoami = whoami,
+            .add_dir = add_dir,
+            .arg = arg,
+        };
+
+        ctx.name_offset = strlen(full_path);
+        ctx.entry_full_path = checked_malloc(ctx.name_offset + 1 + sizeof(entp->d_name)); /* freed below */
+        strcpy(ctx.entry_full_path, full_path);
+        if (ctx.name_offset == 0 || full_path[ctx.name_offset-1] != '/') {
+            ctx.entry_full_path[ctx.name_offset++] = '/';
+        }
+
+        if (conf->scan_inode_order) {
+            scan_dir_read_entries_by_inode(&ctx, dir);
+        } else {
+            while ((entp = readdir(dir)) != NULL) {
+                if (strcmp(entp->d_name, ".") != 0 && strcmp(entp->d_name, "..") != 0) {
+                    scan_dir_read_entry(&ctx, entp->d_name, scan_dir_get_d_type(entp));
+                }
+            }
+        }
+        free(ctx.entry_full_path);
+        if (ctx.handle) {
+            scan_dir_handle_release(ctx.handle);
+        } else {
+            closedir(dir);
+        }
+    }
+}
+
+static void scan_stack_add_dir(scan_dir_item *item, void *stack) {
+    queue_enqueue(stack, item);
+}
+
+/*
+ * Parallel directory traversal
+ *
+ * Every scan worker owns a deque of directories. New child directories are
+ * pushed to and popped from the bottom of the own deque, idle scan workers
+ * steal directories from the top of the other workers' deques.
+ */
+
+typedef struct scan_deque {
+    pthread_mutex_t mutex;
+    scan_dir_item **items;
+    size_t size;
+    size_t top;
+    size_t bottom;
+} scan_deque;
+
+typedef struct scan_worker {
+    long index;
+    char whoami[32];
+} scan_worker;
+
+static scan_deque *scan_deques = NULL;
+
+static pthread_mutex_t scan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scan_cond = PTHREAD_COND_INITIALIZER;
+static long scan_queued = 0; /* number of directories in all deques */
+static long scan_pending = 0; /* number of queued or currently processed directories */
+static long scan_idle = 0;
+
+static void scan_deque_push(scan_deque *deque, scan_dir_item *item) {
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->bottom == deque->size) {
+        if (deque->top) {
+            memmove(deque->items, &deque->items[deque->top], (deque->bottom-deque->top)*sizeof(scan_dir_item*));
+            deque->bottom -= deque->top;
+            deque->top = 0;
+        } else {
+            deque->size = deque->size?2*deque->size:64;
+            deque->items = checked_realloc(deque->items, deque->size*sizeof(scan_dir_item*)); /* freed in scan_dir_parallel */
+        }
+    }
+    deque->items[deque->bottom++] = item;
+    pthread_mutex_unlock(&deque->mutex);
+}
+
+static scan_dir_item *scan_deque_pop(scan_deque *deque) {
+    scan_dir_item *item = NULL;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->bottom > deque->top) {
+        item = deque->items[--deque->bottom];
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return item;
+}
+
+static scan_dir_item *scan_deque_steal(scan_deque *deque) {
+    scan_dir_item *item = NULL;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->bottom > deque->top) {
+        item = deque->items[deque->top++];
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return item;
+}
+
+static void scan_worker_add_dir(scan_dir_item *item, void *arg) {
+    scan_worker *worker = arg;
+    /* count the item before it can be stolen (and finished) by another worker */
+    pthread_mutex_lock(&scan_mutex);
+    scan_queued++;
+    scan_pending++;
+    scan_deque_push(&scan_deques[worker->index], item);
+    if (scan_idle) {
+        pthread_cond_signal(&scan_cond);
+    }
+    pthread_mutex_unlock(&scan_mutex);
+}
+
+static scan_dir_item *scan_worker_get_dir(scan_worker *worker) {
+    scan_dir_item *item = NULL;
+    while (1) {
+        item = scan_deque_pop(&scan_deques[worker->index]);
+        for (long i = 1; item == NULL && i < conf->num_scan_workers; ++i) {
+            long victim = (worker->index+i)%conf->num_scan_workers;
+            if ((item = scan_deque_steal(&scan_deques[victim])) != NULL) {
+                log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: stole directory '%s' from scan worker #%ld", worker->whoami, item->full_path, victim+1);
+            }
+        }
+        pthread_mutex_lock(&scan_mutex);
+        if (item) {
+            scan_queued--;
+            pthread_mutex_unlock(&scan_mutex);
+            return item;
+        }
+        while (scan_queued == 0 && scan_pending > 0) {
+            scan_idle++;
+            log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: wait for directories", worker->whoami);
+            pthread_cond_wait(&scan_cond, &scan_mutex);
+            scan_idle--;
+        }
+        if (scan_pending == 0) {
+            pthread_mutex_unlock(&scan_mutex);
+            return NULL;
+        }
+        pthread_mutex_unlock(&scan_mutex);
+    }
+}
+
+static void * scan_dir_worker(void *arg) {
+    scan_worker *worker = arg;
+
+    mask_sig(worker->whoami);
+
+    log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir_worker: initialized scan worker thread #%ld", worker->whoami, worker->index+1);
+
+    scan_dir_item *item;
+    while ((item = scan_worker_get_dir(worker)) != NULL) {
+        scan_dir_read_directory(item, false, worker->whoami, &scan_worker_add_dir, worker);
+        scan_dir_item_free(item);
+
+        pthread_mutex_lock(&scan_mutex);
+        if (--scan_pending == 0) {
+            pthread_cond_broadcast(&scan_cond);
+        }
+        pthread_mutex_unlock(&scan_mutex);
+    }
+    log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir_worker: no directories left, exit thread", worker->whoami);
+
+    return (void *) pthread_self();
+}
+
+static void scan_dir_parallel(char *root_path) {
+    long num_scan_workers = conf->num_scan_workers;
+
+    scan_deques = checked_calloc(num_scan_workers, sizeof(scan_deque)); /* freed below */
+    scan_worker *workers = checked_malloc(num_scan_workers * sizeof(scan_worker)); /* freed below */
+    pthread_t *threads = checked_malloc(num_scan_workers * sizeof(pthread_t)); /* freed below */
+
+    for (long i = 0 ; i < num_scan_workers ; ++i) {
+        pthread_mutex_init(&scan_deques[i].mutex, NULL);
+        workers[i].index = i;
+        snprintf(workers[i].whoami, 32, "(scan-%03li)", i+1);
+    }
+
+    scan_queued = 1;
+    scan_pending = 1;
+    scan_deque_push(&scan_deques[0], scan_dir_item_new(checked_strdup(root_path), 0, NULL)); /* freed in scan_dir_worker */
+
+    for (long i = 0 ; i < num_scan_workers ; ++i) {
+        if (pthread_create(&threads[i], NULL, &scan_dir_worker, &workers[i]) != 0) {
+            log_msg(LOG_LEVEL_ERROR, "failed to start scan worker thread #%ld", i+1);
+            exit(THREAD_ERROR);
+        }
+    }
+    for (long i = 0 ; i < num_scan_workers ; ++i) {
+        if (pthread_join(threads[i], NULL) != 0) {
+            log_msg(LOG_LEVEL_ERROR, "failed to join scan worker thread #%ld", i+1);
+            exit(THREAD_ERROR);
+        }
+        log_msg(LOG_LEVEL_THREAD, "%10s: scan worker thread #%ld finished", whoami_main, i+1);
+    }
+
+    for (long i = 0 ; i < num_scan_workers ; ++i) {
+        pthread_mutex_destroy(&scan_deques[i].mutex);
+        free(scan_deques[i].items);
+    }
+    free(scan_deques);
+    scan_deques = NULL;
+    free(workers);
+    free(threads);
+}
+
 void scan_dir(char *root_path, bool dry_run) {
-    char* full_path;
+    scan_dir_item *item;
     struct stat fs;
+    time_t btime;
 
     log_msg(LOG_LEVEL_DEBUG,"scan_dir: process root directory '%s' (fullpath: '%s')", &root_path[conf->root_prefix_length], root_path);
-    if (!get_file_status(root_path, &fs)) {
+    if (!get_file_status(-1, NULL, root_path, &fs, &btime)) {
         match_t path_match = check_rxtree (&root_path[conf->root_prefix_length], conf->tree, get_restriction_from_perm(fs.st_mode), "disk", false);
         if (dry_run) {
             print_match(&root_path[conf->root_prefix_length], path_match, get_restriction_from_perm(fs.st_mode));
         }
         if (!dry_run && path_match.result&(RESULT_EQUAL_MATCH|RESULT_SELECTIVE_MATCH)) {
-            handle_matched_file(root_path, path_match.rule->attr, fs);
+            handle_matched_file(root_path, path_match.rule->attr, fs, btime, whoami_main);
         }
         if (path_match.result & (RESULT_NO_RULE_MATCH|RESULT_NON_RECURSIVE_NEGATIVE_MATCH|RESULT_PART_LIMIT_AND_NO_RECURSE_MATCH)) {
+            if (conf->num_workers && !dry_run) {
+                release_worker_files(whoami_main);
+            }
             return;
         }
     }
 
-    queue_ts_t *stack = queue_init(NULL);
-    log_msg(LOG_LEVEL_TRACE, "initialized scan stack queue %p", (void*) stack);
+    if (conf->scan_dirfd) {
+        scan_max_open_handles = scan_dir_get_max_open_handles();
+        log_msg(LOG_LEVEL_DEBUG, "scan_dir: scan directories relative to their parent directory (keep at most %ld directories open)", scan_max_open_handles);
+    }
 
-    queue_enqueue(stack, checked_strdup(root_path)); /* freed below */
+    if (!dry_run && conf->num_workers && conf->num_scan_workers > 1) {
+        log_msg(LOG_LEVEL_DEBUG, "scan_dir: scan directories using %ld scan workers", conf->num_scan_workers);
+        scan_dir_parallel(root_path);
+    } else {
+        queue_ts_t *stack = queue_init(NULL);
+        log_msg(LOG_LEVEL_TRACE, "initialized scan stack queue %p", (void*) stack);
 
-    while((full_path = queue_dequeue(stack)) != NULL) {
-        DIR *dir;
-        char *file_path = &full_path[conf->root_prefix_length];
-        log_msg(LOG_LEVEL_DEBUG,"scan_dir: process directory '%s' (fullpath: '%s')", file_path, full_path);
-        if((dir = opendir(full_path)) == NULL) {
-            log_msg(LOG_LEVEL_WARNING,"opendir() failed for '%s' (fullpath: '%s'): %s", file_path, full_path, strerror(errno));
-        } else {
-            struct dirent *entp;
-            while ((entp = readdir(dir)) != NULL) {
-                LOG_LEVEL log_level = LOG_LEVEL_TRACE;
-                if (strcmp(entp->d_name, ".") != 0 && strcmp(entp->d_name, "..") != 0) {
-                    char *entry_full_path = name_construct(full_path, entp->d_name);
-                    bool free_entry_full_path = true;
-                    log_msg(log_level, "scan_dir: process child directory '%s' (fullpath: '%s')", &entry_full_path[conf->root_prefix_length], entry_full_path);
-                    if (!get_file_status(entry_full_path, &fs)) {
-                        match_t path_match = check_rxtree (&entry_full_path[conf->root_prefix_length], conf->tree, get_restriction_from_perm(fs.st_mode), "disk", false);
-                        switch (path_match.result) {
-                            case RESULT_SELECTIVE_MATCH:
-                            case RESULT_EQUAL_MATCH:
-                                if (S_ISDIR(fs.st_mode)) {
-                                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: selective/equal match)", &entry_full_path[conf->root_prefix_length]);
-                                    queue_enqueue(stack, entry_full_path);
-                                    free_entry_full_path = false;
-                                }
-                                if (!dry_run) {
-                                    handle_matched_file(entry_full_path, path_match.rule->attr, fs);
-                                }
-                                break;
-                            case RESULT_PARTIAL_MATCH:
-                                if (S_ISDIR(fs.st_mode)) {
-                                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: partial match)", &entry_full_path[conf->root_prefix_length]);
-                                    queue_enqueue(stack, entry_full_path);
-                                    free_entry_full_path = false;
-                                }
-                                break;
-                            case RESULT_RECURSIVE_NEGATIVE_MATCH:
-                                if (S_ISDIR(fs.st_mode)) {
-                                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: recursive negative match)", &entry_full_path[conf->root_prefix_length]);
-                                    queue_enqueue(stack, entry_full_path);
-                                    free_entry_full_path = false;
-                                }
-                                break;
-                            case RESULT_PARTIAL_LIMIT_MATCH:
-                                if(S_ISDIR(fs.st_mode)) {
-                                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: partial limit match)", &entry_full_path[conf->root_prefix_length]);
-                                    queue_enqueue(stack, entry_full_path);
-                                    free_entry_full_path = false;
-                                }
-                                break;
-                            case RESULT_NON_RECURSIVE_NEGATIVE_MATCH:
-                                if(S_ISDIR(fs.st_mode)) {
-                                    log_msg(log_level, "scan_dir: do NOT add child directory '%s' to scan stack (reason: non-recursive negative match)", &entry_full_path[conf->root_prefix_length]);
-                                }
-                                break;
-                            case RESULT_NEGATIVE_PARENT_MATCH:
-                            case RESULT_NO_RULE_MATCH:
-                            case RESULT_NO_LIMIT_MATCH:
-                            case RESULT_PART_LIMIT_AND_NO_RECURSE_MATCH:
-                                break;
-                        }
-                        if (dry_run) {
-                            print_match(&entry_full_path[conf->root_prefix_length], path_match, get_restriction_from_perm(fs.st_mode));
-                        }
-                    }
-                    if (free_entry_full_path) {
-                        free(entry_full_path);
-                    }
-                }
-            }
-            closedir(dir);
+        queue_enqueue(stack, scan_dir_item_new(checked_strdup(root_path), 0, NULL)); /* freed below */
+
+        while((item = queue_dequeue(stack)) != NULL) {
+            scan_dir_read_directory(item, dry_run, whoami_main, &scan_stack_add_dir, stack);
+            scan_dir_item_free(item);
         }
-        free(full_path);
-        full_path = NULL;
+        queue_free(stack);
     }
     if (conf->num_workers && !dry_run) {
-        queue_ts_release(queue_worker_files, whoami_main);
+        release_worker_files(whoami_main);
     }
-    queue_free(stack);
 }
 
-static void * add2tree( __attribute__((unused)) void *arg) {
-    const char *whoami = "(add2tree)";
+/*
+ * Database entries are sharded by their parent directory, so all entries of
+ * a directory (which are compared with each other to detect moved files) are
+ * added to the tree by the same add2tree thread.
+ */
+static long get_tree_shard(const char *filename) {
+    if (conf->num_tree_workers < 2) {
+        return 0;
+    }
+    const char *last_slash = strrchr(filename, '/');
+    size_t length = last_slash ? (size_t) (last_slash - filename) : 0;
+    /* FNV-1a */
+    unsigned long hash = 2166136261LU;
+    for (size_t i = 0 ; i < length ; ++i) {
+        hash ^= (unsigned char) filename[i];
+        hash *= 16777619LU;
+    }
+    return hash % conf->num_tree_workers;
+}
+
+static void * add2tree(void *arg) {
+    long tree_worker_index = (long) arg;
+    char whoami[32];
+    snprintf(whoami, 32, "(tree-%03li)", tree_worker_index+1);
+    ring_ts_t *queue = queue_database_entries[tree_worker_index];
 
     mask_sig(whoami);
 
+    /* queue depth statistics (sampled before every batch) */
+    unsigned long entries = 0LU, samples = 0LU;
+    size_t depth_sum = 0, depth_max = 0;
+    time_t last_log = time(NULL);
+
     log_msg(LOG_LEVEL_THREAD, "%10s: wait for database entries", whoami);
-    database_entry *data;
-    while ((data = queue_ts_dequeue_wait(queue_database_entries, whoami)) != NULL) {
-        log_msg(LOG_LEVEL_THREAD, "%10s: got line '%s'", whoami, (data->line)->filename);
-        add_file_to_tree(conf->tree, data->line, DB_NEW|DB_DISK, NULL, &data->fs);
-        free(data);
+    database_entry *data[ADD2TREE_BATCH_SIZE];
+    size_t n;
+    while ((n = ring_ts_dequeue_batch_wait(queue, (void **) data, ADD2TREE_BATCH_SIZE, whoami)) > 0) {
+        size_t depth = ring_ts_size(queue) + n;
+        samples++;
+        depth_sum += depth;
+        if (depth > depth_max) {
+            depth_max = depth;
+        }
+        time_t now = time(NULL);
+        if (now != last_log) {
+            log_msg(LOG_LEVEL_DEBUG, "%10s: database entries queue depth: %zu/%zu", whoami, depth, ring_ts_capacity(queue));
+            last_log = now;
+        }
+        for (size_t i = 0 ; i < n ; ++i) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: got line '%s'", whoami, (data[i]->line)->filename);
+            add_file_to_tree(conf->tree, data[i]->line, DB_NEW|DB_DISK, NULL, &data[i]->fs);
+            free(data[i]);
+        }
+        entries += n;
     }
-    queue_ts_free(queue_database_entries);
+    log_msg(LOG_LEVEL_INFO, "%10s: added %lu entries to the tree (database entries queue depth: avg %.1f, max %zu, capacity %zu)", whoami, entries, samples ? (double) depth_sum/samples : 0., depth_max, ring_ts_capacity(queue));
+    ring_ts_free(queue);
     log_msg(LOG_LEVEL_TRACE, "%10s: finished (queue empty)", whoami);
 
     return (void *) pthread_self();
@@ -227,27 +1068,165 @@ void db_scan_disk(bool dry_run) {
     strncpy(full_path, conf->root_prefix, conf->root_prefix_length+1);
     strcat (full_path, "/");
 
-    pthread_t add2tree_thread = 0;
+    pthread_t *add2tree_threads = NULL;
 
     if (!dry_run && conf->num_workers) {
-        if (pthread_create(&add2tree_thread, NULL, &add2tree, NULL) != 0) {
-            log_msg(LOG_LEVEL_ERROR, "failed to start add2tree thread");
-            exit(THREAD_ERROR);
+        add2tree_threads = checked_malloc(conf->num_tree_workers * sizeof(pthread_t)); /* freed below */
+        for (long i = 0 ; i < conf->num_tree_workers ; ++i) {
+            if (pthread_create(&add2tree_threads[i], NULL, &add2tree, (void *) i) != 0) {
+                log_msg(LOG_LEVEL_ERROR, "failed to start add2tree thread #%ld", i+1);
+                exit(THREAD_ERROR);
+            }
         }
     }
 
     scan_dir(full_path, dry_run);
 
     if (!dry_run && conf->num_workers) {
-        if (pthread_join(add2tree_thread, NULL) != 0) {
-            log_msg(LOG_LEVEL_ERROR, "failed to join add2tree thread");
-            exit(THREAD_ERROR);
+        for (long i = 0 ; i < conf->num_tree_workers ; ++i) {
+            if (pthread_join(add2tree_threads[i], NULL) != 0) {
+                log_msg(LOG_LEVEL_ERROR, "failed to join add2tree thread #%ld", i+1);
+                exit(THREAD_ERROR);
+            }
         }
+        free(add2tree_threads);
+        free(queue_database_entries);
+        queue_database_entries = NULL;
     }
 
     free(full_path);
 }
 
+static void process_worker_file(scan_dir_entry *data, md_hashsums *hs, const char *whoami) {
+    log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_workers: got entry %p from list of files (filename: '%s' (%p))", whoami, (void*) data, data->filename, (void*) data->filename);
+
+    dev_t dev = data->fs.st_dev;
+    db_line *line = get_file_attrs (data->filename, data->attr, &data->fs, data->btime, hs);
+    database_entry *db_data;
+    db_data = checked_malloc(sizeof(database_entry)); /* freed in db_scan_disk */
+    db_data->line = line;
+    db_data->fs = data->fs;
+    log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: add entry %p to list of database entries (filename: '%s')", whoami, (void*) line, line->filename);
+    ring_ts_enqueue(queue_database_entries[get_tree_shard(line->filename)], db_data, whoami);
+
+    worker_files_done(dev);
+    free(data);
+}
+
+/*
+ * Processes the files whose hashsums are already known (see
+ * has_known_hashsums) and returns the number of remaining files (moved to
+ * the front)
+ */
+static int skip_known_files(scan_dir_entry **data, int n, const char *whoami) {
+    int remaining = 0;
+    for (int i = 0 ; i < n ; ++i) {
+        if (has_known_hashsums(data[i])) {
+            process_worker_file(data[i], NULL, whoami);
+        } else {
+            data[remaining++] = data[i];
+        }
+    }
+    return remaining;
+}
+
+#ifdef WITH_URING
+/*
+ * Takes up to URING_MAX_FILES files from the queue (only waits for the first
+ * one) and calculates their hashsums using the io_uring engine
+ */
+static void file_attrs_worker_uring(uring_engine *engine, const char *whoami) {
+    scan_dir_entry *data[URING_MAX_FILES];
+    uring_hash_request reqs[URING_MAX_FILES];
+
+    while (1) {
+        log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: check/wait for files", whoami);
+        int n = worker_files_dequeue_batch(data, URING_MAX_FILES, whoami);
+        if (n == 0) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: queue empty, exit thread", whoami);
+            break;
+        }
+        n = skip_known_files(data, n, whoami);
+        for (int i = 0 ; i < n ; ++i) {
+            reqs[i].fullpath = data[i]->filename;
+            reqs[i].attr = data[i]->attr;
+            reqs[i].fs = &data[i]->fs;
+        }
+        uring_calc_hashsums(engine, reqs, n);
+        for (int i = 0 ; i < n ; ++i) {
+            process_worker_file(data[i], reqs[i].done?&reqs[i].hashsums:NULL, whoami);
+        }
+    }
+}
+#endif
+
+/*
+ * Takes up to small_file_batch files from the queue (only waits for the first
+ * one) and calculates the hashsums of the small ones at once
+ */
+static void file_attrs_worker_small_files(const char *whoami) {
+    scan_dir_entry *data[SMALL_FILES_BATCH_SIZE];
+    small_hash_request reqs[SMALL_FILES_BATCH_SIZE];
+    size_t batch_size = conf->small_file_batch < SMALL_FILES_BATCH_SIZE ? conf->small_file_batch : SMALL_FILES_BATCH_SIZE;
+
+    while (1) {
+        log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: check/wait for files", whoami);
+        int n = worker_files_dequeue_batch(data, batch_size, whoami);
+        if (n == 0) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: queue empty, exit thread", whoami);
+            break;
+        }
+        n = skip_known_files(data, n, whoami);
+        for (int i = 0 ; i < n ; ++i) {
+            reqs[i].fullpath = data[i]->filename;
+            reqs[i].attr = data[i]->attr;
+            reqs[i].fs = &data[i]->fs;
+        }
+        calc_small_hashsums(reqs, n);
+        for (int i = 0 ; i < n ; ++i) {
+            process_worker_file(data[i], reqs[i].done?&reqs[i].hashsums:NULL, whoami);
+        }
+    }
+}
+
+static void prefetch_worker_file(scan_dir_entry *data) {
+    if (data->attr&get_available_hashes() && !has_known_hashsums(data)) {
+        prefetch_file(data->filename, &data->fs);
+    }
+}
+
+/*
+ * Keeps up to prefetch_files files in a private window and starts the
+ * read-ahead of the queued files while hashing the current one
+ */
+static void file_attrs_worker_prefetch(const char *whoami) {
+    size_t window_size = conf->prefetch_files + 1;
+    scan_dir_entry **window = checked_malloc(window_size * sizeof(scan_dir_entry*)); /* freed below */
+    size_t n = 0;
+
+    while (1) {
+        if (n == 0) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: check/wait for files", whoami);
+            if ((n = worker_files_dequeue_batch(window, window_size, whoami)) == 0) {
+                log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: queue empty, exit thread", whoami);
+                break;
+            }
+            for (size_t i = 1 ; i < n ; ++i) {
+                prefetch_worker_file(window[i]);
+            }
+        } else {
+            scan_dir_entry *data;
+            while (n < window_size && (data = worker_files_dequeue(false, whoami)) != NULL) {
+                prefetch_worker_file(data);
+                window[n++] = data;
+            }
+        }
+        process_worker_file(window[0], NULL, whoami);
+        memmove(&window[0], &window[1], (--n) * sizeof(scan_dir_entry*));
+    }
+    free(window);
+}
+
 static void * file_attrs_worker( __attribute__((unused)) void *arg) {
     long worker_index = (long) arg;
     char whoami[32];
@@ -257,21 +1236,30 @@ static void * file_attrs_worker( __attribute__((unused)) void *arg) {
 
     log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: initialized worker thread #%ld", whoami, worker_index);
 
+#ifdef WITH_URING
+    uring_engine *engine;
+    if (conf->io_uring && (engine = uring_engine_init(whoami)) != NULL) {
+        file_attrs_worker_uring(engine, whoami);
+        uring_engine_free(engine);
+        return (void *) pthread_self();
+    }
+#endif
+
+    if (conf->prefetch_files > 0) {
+        file_attrs_worker_prefetch(whoami);
+        return (void *) pthread_self();
+    }
+
+    if (conf->small_file_batch > 1) {
+        file_attrs_worker_small_files(whoami);
+        return (void *) pthread_self();
+    }
+
     while (1) {
         log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: check/wait for files", whoami);
-        scan_dir_entry *data = queue_ts_dequeue_wait(queue_worker_files, whoami);
+        scan_dir_entry *data = worker_files_dequeue(true, whoami);
         if (data) {
-            log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_workers: got entry %p from list of files (filename: '%s' (%p))", whoami, (void*) data, data->filename, (void*) data->filename);
-
-            db_line *line = get_file_attrs (data->filename, data->attr, &data->fs);
-            database_entry *db_data;
-            db_data = checked_malloc(sizeof(database_entry)); /* freed in db_scan_disk */
-            db_data->line = line;
-            db_data->fs = data->fs;
-            log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: add entry %p to list of database entries (filename: '%s')", whoami, (void*) line, line->filename);
-            queue_ts_enqueue(queue_database_entries, db_data, whoami);
-
-            free(data);
+            process_worker_file(data, NULL, whoami);
         } else {
             log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: queue empty, exit thread", whoami);
             break;
@@ -294,15 +1282,27 @@ static void * wait_for_workers( __attribute__((unused)) void *arg) {
         log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker thread #%d finished", whoami, i);
     }
     free(file_attributes_threads);
-    queue_ts_release(queue_database_entries, whoami);
-    queue_ts_free(queue_worker_files);
+    for (long i = 0 ; i < conf->num_tree_workers ; ++i) {
+        ring_ts_release(queue_database_entries[i], whoami);
+    }
+    ring_ts_free(queue_worker_files);
+    for (long i = 0 ; i < num_device_queues ; ++i) {
+        ring_ts_free(device_queues[i].files);
+    }
+    free(device_queues);
+    device_queues = NULL;
+    num_device_queues = 0;
+    device_release = false;
     return (void *) pthread_self();
 }
 
 int db_disk_start_threads(void) {
-    queue_database_entries = queue_ts_init(NULL); /* freed in add2tree */
-    log_msg(LOG_LEVEL_THREAD, "%10s: initialized database entries queue %p", whoami_main, (void*) queue_database_entries);
-    queue_worker_files = queue_ts_init(NULL); /* freed in wait_for_workers */
+    queue_database_entries = checked_malloc(conf->num_tree_workers * sizeof(ring_ts_t*)); /* freed in db_scan_disk */
+    for (long i = 0 ; i < conf->num_tree_workers ; ++i) {
+        queue_database_entries[i] = ring_ts_init(conf->num_workers * QUEUE_SLOTS_PER_WORKER / conf->num_tree_workers); /* freed in add2tree */
+        log_msg(LOG_LEVEL_THREAD, "%10s: initialized database entries queue #%ld %p", whoami_main, i+1, (void*) queue_database_entries[i]);
+    }
+    queue_worker_files = ring_ts_init(conf->num_workers * QUEUE_SLOTS_PER_WORKER); /* freed in wait_for_workers */
     log_msg(LOG_LEVEL_THREAD, "%10s: initialized worker files queue %p", whoami_main, (void*) queue_worker_files);
 
     file_attributes_threads = checked_malloc(conf->num_workers * sizeof(pthread_t)); /* freed in wait_for_workers */
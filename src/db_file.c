@@ -591,6 +591,10 @@ int db_writeline_file(db_line* line,db_config* dbconf, url_t* url){
       db_write_time_base64(line->ctime,dbconf->database_out.fp,i);
       break;
     }
+    case attr_btime : {
+      db_write_time_base64(line->btime,dbconf->database_out.fp,i);
+      break;
+    }
     case attr_inode : {
       db_writelong(line->inode,dbconf->database_out.fp,i);
       break;
@@ -625,6 +629,9 @@ int db_writeline_file(db_line* line,db_config* dbconf, url_t* url){
     WRITE_HASHSUM(gostr3411_94)
     WRITE_HASHSUM(stribog256)
     WRITE_HASHSUM(stribog512)
+    WRITE_HASHSUM(blake3)
+    WRITE_HASHSUM(xxh3)
+    WRITE_HASHSUM(crc32c)
     WRITE_HASHSUM(sha256)
     WRITE_HASHSUM(sha512)
     WRITE_HASHSUM(whirlpool)
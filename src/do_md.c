@@ -24,14 +24,21 @@
 #include <stdbool.h>
 
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/stat.h>
+#ifdef HAVE_STATX
+#include <sys/sysmacros.h>
+#endif
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <setjmp.h>
+#include <stdatomic.h>
+#include <signal.h>
 #include <sys/wait.h>
 
 #ifdef WITH_ZLIB
@@ -66,7 +73,9 @@
 #endif
 
 
+#include "aide.h"
 #include "md.h"
+#include "native_hash.h"
 #include "do_md.h"
 
 #include "hashsum.h"
@@ -75,9 +84,158 @@
 #include "util.h"
 #include "log.h"
 #include "attributes.h"
+#include "tree.h"
+#include "errorcodes.h"
+
+/*
+ * Read buffer of the calling thread
+ *
+ * The buffer is page-aligned, reused for all files hashed by the thread and
+ * only grown up to 'read_block_size' if a larger file needs it. It is freed
+ * when the thread exits.
+ */
+
+typedef struct read_buffer {
+    char *buf;
+    size_t size;
+    /* page cache residency of the current file (see drop_page_cache) */
+    unsigned char *resident;
+    size_t resident_size;
+} read_buffer;
+
+static pthread_key_t read_buffer_key;
+static pthread_once_t read_buffer_key_once = PTHREAD_ONCE_INIT;
+
+static void free_read_buffer(void *p) {
+    read_buffer *buffer = p;
+    free(buffer->buf);
+    free(buffer->resident);
+    free(buffer);
+}
 
-/* This define should be somewhere else */
-#define READ_BLOCK_SIZE 16777216
+static void create_read_buffer_key(void) {
+    if (pthread_key_create(&read_buffer_key, free_read_buffer) != 0) {
+        log_msg(LOG_LEVEL_ERROR, "failed to create read buffer key");
+        exit(THREAD_ERROR);
+    }
+}
+
+static read_buffer *get_thread_read_buffer(void) {
+    pthread_once(&read_buffer_key_once, create_read_buffer_key);
+
+    read_buffer *buffer = pthread_getspecific(read_buffer_key);
+    if (buffer == NULL) {
+        buffer = checked_malloc(sizeof(read_buffer)); /* freed in free_read_buffer */
+        buffer->buf = NULL;
+        buffer->size = 0;
+        buffer->resident = NULL;
+        buffer->resident_size = 0;
+        pthread_setspecific(read_buffer_key, buffer);
+    }
+    return buffer;
+}
+
+/* returns the read buffer of the calling thread with at least the size needed for the file */
+static char *get_read_buffer(off_t file_size, bool full_block, size_t *buf_size) {
+    read_buffer *buffer = get_thread_read_buffer();
+
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t size = conf->read_block_size;
+    if (!full_block && file_size >= 0 && (unsigned long long) file_size < size) {
+        /* one more byte to detect growing files with a single read */
+        size = ((file_size + 1 + page_size - 1)/page_size)*page_size;
+        if (size > (size_t) conf->read_block_size) {
+            size = conf->read_block_size;
+        }
+    }
+    /* direct I/O (see direct_io) needs a multiple of the page size */
+    size = ((size + page_size - 1)/page_size)*page_size;
+    if (buffer->size < size) {
+        free(buffer->buf);
+        buffer->buf = checked_aligned_alloc(page_size, size); /* freed in free_read_buffer */
+        buffer->size = size;
+        log_msg(LOG_LEVEL_DEBUG, "allocated read buffer of %zu bytes", size);
+    }
+    *buf_size = buffer->size;
+    return buffer->buf;
+}
+
+/*
+ * mmap based hashsum calculation (see mmap_threshold)
+ *
+ * The file is mapped in windows of MMAP_WINDOW_SIZE bytes. Accessing a page
+ * beyond the end of a file truncated in the meantime raises SIGBUS, which is
+ * caught and turned into a failed hashsum calculation of the file.
+ */
+
+/* has to be a multiple of the page size */
+#define MMAP_WINDOW_SIZE 67108864
+
+/* volatile: only read by the signal handler */
+static _Thread_local sigjmp_buf * volatile mmap_sigbus_jmp_buf = NULL;
+static pthread_once_t mmap_sigbus_handler_once = PTHREAD_ONCE_INIT;
+
+static void mmap_sigbus_handler(int signum) {
+    if (mmap_sigbus_jmp_buf) {
+        siglongjmp(*mmap_sigbus_jmp_buf, 1);
+    }
+    /* SIGBUS not raised by a mapped file */
+    signal(signum, SIG_DFL);
+    raise(signum);
+}
+
+static void install_mmap_sigbus_handler(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = mmap_sigbus_handler;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGBUS, &sa, NULL) != 0) {
+        log_msg(LOG_LEVEL_WARNING, "failed to install SIGBUS handler: %s", strerror(errno));
+    }
+}
+
+/* returns the number of bytes hashed (to be continued with read()) or -1 on error */
+static off_t mmap_update_md(struct md_container *mdc, int fd, off_t size, const char *fullpath) {
+    pthread_once(&mmap_sigbus_handler_once, install_mmap_sigbus_handler);
+
+    sigjmp_buf jmp_buf;
+    volatile off_t offset = 0;
+    void * volatile window = NULL;
+    volatile size_t window_size = 0;
+
+    if (sigsetjmp(jmp_buf, 1)) {
+        mmap_sigbus_jmp_buf = NULL;
+        munmap(window, window_size);
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: SIGBUS while reading '%s' at offset %lld, was file truncated while AIDE was running? (hashsums could not be calculated)", fullpath, (long long) offset);
+        return -1;
+    }
+    mmap_sigbus_jmp_buf = &jmp_buf;
+
+    while (offset < size) {
+        window_size = size - offset > MMAP_WINDOW_SIZE ? MMAP_WINDOW_SIZE : size - offset;
+        void *map = mmap(NULL, window_size, PROT_READ, MAP_SHARED, fd, offset);
+        if (map == MAP_FAILED) {
+            log_msg(LOG_LEVEL_DEBUG, "%s> mmap() failed at offset %lld: %s (continue with read())", fullpath, (long long) offset, strerror(errno));
+            break;
+        }
+        window = map;
+#ifdef HAVE_MADVISE
+        madvise(map, window_size, MADV_SEQUENTIAL);
+        madvise(map, window_size, MADV_WILLNEED);
+#endif
+        if (update_md(mdc, map, window_size) != RETOK) {
+            mmap_sigbus_jmp_buf = NULL;
+            munmap(map, window_size);
+            log_msg(LOG_LEVEL_WARNING, "hash calculation: update_md() failed for '%s' (hashsums could not be calculated)", fullpath);
+            return -1;
+        }
+        munmap(map, window_size);
+        window = NULL;
+        offset += window_size;
+    }
+    mmap_sigbus_jmp_buf = NULL;
+    return offset;
+}
 
 typedef union fd {
     int plain;
@@ -94,11 +252,132 @@ typedef enum compression {
     COMPRESSION_ERROR
 } compression;
 
+/*
+ * Page cache eviction (see drop_page_cache)
+ *
+ * Before the file is read, the page cache residency of the file is recorded
+ * with mincore(2) (per page for files up to PAGE_CACHE_MAX_CHUNKS pages,
+ * sampled for larger files). The ranges read from the file are then dropped
+ * from the page cache with POSIX_FADV_DONTNEED, except for the pages which
+ * were already resident before.
+ */
+
+#define PAGE_CACHE_MAX_CHUNKS 65536
+
+typedef struct page_cache_state {
+    off_t size;
+    off_t chunk_size;
+    size_t num_chunks;
+    unsigned char *resident;
+    size_t next_chunk; /* first chunk not yet dropped */
+} page_cache_state;
+
+/* returns false if the residency of the file could not be determined */
+static bool init_page_cache_state(page_cache_state *state, int filedes, off_t size, const char *fullpath) {
+#if defined HAVE_POSIX_FADVISE && defined HAVE_MINCORE
+    if (size <= 0) {
+        return false;
+    }
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t num_pages = (size + page_size - 1)/page_size;
+    state->size = size;
+    state->chunk_size = page_size;
+    if (num_pages > PAGE_CACHE_MAX_CHUNKS) {
+        state->chunk_size = ((num_pages + PAGE_CACHE_MAX_CHUNKS - 1)/PAGE_CACHE_MAX_CHUNKS)*page_size;
+    }
+    state->num_chunks = (size + state->chunk_size - 1)/state->chunk_size;
+    state->next_chunk = 0;
+
+    read_buffer *buffer = get_thread_read_buffer();
+    if (buffer->resident_size < state->num_chunks) {
+        buffer->resident = checked_realloc(buffer->resident, state->num_chunks); /* freed in free_read_buffer */
+        buffer->resident_size = state->num_chunks;
+    }
+    state->resident = buffer->resident;
+
+    /* mapping the file does not fault in any page */
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, filedes, 0);
+    if (map == MAP_FAILED) {
+        log_msg(LOG_LEVEL_DEBUG, "%s> mmap() failed for '%s': %s (do not drop page cache)", fullpath, fullpath, strerror(errno));
+        return false;
+    }
+    int res = 0;
+    if (state->chunk_size == (off_t) page_size) {
+        res = mincore(map, size, state->resident);
+    } else {
+        /* sample the first page of every chunk */
+        for (size_t i = 0 ; res == 0 && i < state->num_chunks ; ++i) {
+            res = mincore((char *) map + i*state->chunk_size, page_size, &state->resident[i]);
+        }
+    }
+    if (res != 0) {
+        log_msg(LOG_LEVEL_DEBUG, "%s> mincore() failed for '%s': %s (do not drop page cache)", fullpath, fullpath, strerror(errno));
+    }
+    munmap(map, size);
+    return res == 0;
+#else
+    (void) state; (void) filedes; (void) size; (void) fullpath;
+    return false;
+#endif
+}
+
+/* drops the completely read, previously not resident chunks up to offset from the page cache */
+static void drop_page_cache_range(page_cache_state *state, int filedes, off_t offset) {
+#ifdef HAVE_POSIX_FADVISE
+    size_t end_chunk = offset >= state->size ? state->num_chunks : (size_t) (offset/state->chunk_size);
+    size_t i = state->next_chunk;
+    while (i < end_chunk) {
+        if (state->resident[i]&1) {
+            ++i;
+            continue;
+        }
+        size_t start = i;
+        while (i < end_chunk && !(state->resident[i]&1)) {
+            ++i;
+        }
+        off_t range_offset = start*state->chunk_size;
+        off_t range_length = (off_t) ((i - start)*state->chunk_size);
+        if (posix_fadvise(filedes, range_offset, range_length, POSIX_FADV_DONTNEED) != 0) {
+            log_msg(LOG_LEVEL_DEBUG, "posix_fadvise(POSIX_FADV_DONTNEED) failed for range %lld-%lld", (long long) range_offset, (long long) (range_offset+range_length));
+        }
+    }
+    state->next_chunk = end_chunk;
+#else
+    (void) state; (void) filedes; (void) offset;
+#endif
+}
+
 typedef struct hashsums_file {
     fd fd;
     compression compression;
+    bool direct;
+    off_t offset;
+    page_cache_state *page_cache;
 } hashsums_file;
 
+#ifdef O_DIRECT
+/* returns true if O_DIRECT has been set for the file descriptor */
+static bool enable_direct_io(int filedes, const char *fullpath) {
+    int flags = fcntl(filedes, F_GETFL);
+    if (flags == -1 || fcntl(filedes, F_SETFL, flags|O_DIRECT) == -1) {
+        log_msg(LOG_LEVEL_DEBUG, "%s> O_DIRECT not supported for '%s': %s (use buffered I/O)", fullpath, fullpath, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/* used if the file system refuses a direct read, e.g. for the unaligned tail of the file */
+static bool disable_direct_io(int filedes, const char *fullpath) {
+    int flags = fcntl(filedes, F_GETFL);
+    if (flags == -1 || fcntl(filedes, F_SETFL, flags&~O_DIRECT) == -1) {
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: failed to disable O_DIRECT for '%s': %s", fullpath, strerror(errno));
+        return false;
+    }
+    log_msg(LOG_LEVEL_DEBUG, "%s> direct read refused for '%s', continue with buffered I/O", fullpath, fullpath);
+    return true;
+}
+#endif
+
 int stat_cmp(struct stat* f1,struct stat* f2, bool growing) {
   if (f1==NULL || f2==NULL) {
     return RETFAIL;
@@ -121,8 +400,96 @@ int stat_cmp(struct stat* f1,struct stat* f2, bool growing) {
 	  stat_cmp_helper(st_dev,attr_dev));
 }
 
+#ifdef HAVE_STATX
+/* set by the first thread getting ENOSYS, read by all scanner and worker threads */
+static atomic_bool statx_unsupported = false;
+
+/*
+ * Returns the statx() mask needed to collect the given attributes.
+ * File type, permissions and inode are always needed.
+ */
+unsigned int get_statx_mask(DB_ATTR_TYPE attr) {
+    unsigned int mask = STATX_TYPE|STATX_MODE|STATX_INO;
+    if (attr&ATTR(attr_uid)) { mask |= STATX_UID; }
+    if (attr&ATTR(attr_gid)) { mask |= STATX_GID; }
+    if (attr&(ATTR(attr_size)|ATTR(attr_sizeg)|ATTR(attr_growing))) { mask |= STATX_SIZE; }
+    /* link count and times are needed by the hard link cache */
+    if (attr&get_hashes(true)) { mask |= STATX_SIZE|STATX_NLINK|STATX_MTIME|STATX_CTIME; }
+    if (attr&ATTR(attr_linkcount)) { mask |= STATX_NLINK; }
+    if (attr&ATTR(attr_atime)) { mask |= STATX_ATIME; }
+    if (attr&ATTR(attr_mtime)) { mask |= STATX_MTIME; }
+    if (attr&ATTR(attr_ctime)) { mask |= STATX_CTIME; }
+    if (attr&ATTR(attr_btime)) { mask |= STATX_BTIME; }
+    if (attr&ATTR(attr_bcount)) { mask |= STATX_BLOCKS; }
+    return mask;
+}
+
+/*
+ * Only the fields of mask are copied, so that two calls with the same mask
+ * are comparable with stat_cmp() even if the file system returns more fields
+ */
+void statx2stat(struct statx *stx, unsigned int mask, struct stat *fs) {
+    memset(fs, 0, sizeof(struct stat));
+    mask &= stx->stx_mask;
+    fs->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    fs->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+    fs->st_blksize = stx->stx_blksize;
+    fs->st_mode = stx->stx_mode;
+    fs->st_ino = stx->stx_ino;
+    if (mask&STATX_UID) { fs->st_uid = stx->stx_uid; }
+    if (mask&STATX_GID) { fs->st_gid = stx->stx_gid; }
+    if (mask&STATX_SIZE) { fs->st_size = stx->stx_size; }
+    if (mask&STATX_NLINK) { fs->st_nlink = stx->stx_nlink; }
+    if (mask&STATX_BLOCKS) { fs->st_blocks = stx->stx_blocks; }
+    if (mask&STATX_ATIME) {
+        fs->st_atim.tv_sec = stx->stx_atime.tv_sec;
+        fs->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+    }
+    if (mask&STATX_MTIME) {
+        fs->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+        fs->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+    }
+    if (mask&STATX_CTIME) {
+        fs->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+        fs->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+    }
+}
+#endif
+
+/*
+ * fstatat() replacement which only requests the fields of conf->statx_mask
+ * (if statx() is available)
+ */
+int stat_masked(int dir_fd, const char *path, struct stat *fs, time_t *btime, int flags) {
+    if (btime) {
+        *btime = 0;
+    }
+#ifdef HAVE_STATX
+    if (!atomic_load_explicit(&statx_unsupported, memory_order_relaxed)) {
+        struct statx stx;
+        if (statx(dir_fd, path, flags|AT_STATX_SYNC_AS_STAT, conf->statx_mask, &stx) == 0) {
+            statx2stat(&stx, conf->statx_mask, fs);
+            /* birth time is not part of struct stat */
+            if (btime && stx.stx_mask&STATX_BTIME) {
+                *btime = stx.stx_btime.tv_sec;
+            }
+            return 0;
+        } else if (errno != ENOSYS) {
+            return -1;
+        }
+        if (!atomic_exchange_explicit(&statx_unsupported, true, memory_order_relaxed)) {
+            log_msg(LOG_LEVEL_DEBUG, "statx() is not supported, fall back to fstatat()");
+        }
+    }
+#endif
+    return fstatat(dir_fd, path, fs, flags);
+}
+
 static hashsums_file hashsum_open(int filedes, char* fullpath, bool uncompress) {
     hashsums_file file;
+    file.direct = false;
+    file.offset = 0;
+    file.page_cache = NULL;
 
     if (uncompress) {
         char head[2];
@@ -158,16 +525,29 @@ static hashsums_file hashsum_open(int filedes, char* fullpath, bool uncompress)
     }
 }
 
-static off_t hashsum_read(hashsums_file file, void *buf, size_t count) {
+static off_t hashsum_read(hashsums_file *file, void *buf, size_t count, const char *fullpath) {
     off_t size = -1;
     do {
-        switch (file.compression) {
+        switch (file->compression) {
         case COMPRESSION_PLAIN:
-             size = read(file.fd.plain, buf, count);
+             size = read(file->fd.plain, buf, count);
+#ifdef O_DIRECT
+             if (size == -1 && errno == EINVAL && file->direct) {
+                 if ((file->direct = !disable_direct_io(file->fd.plain, fullpath)) == false) {
+                     errno = EINTR; /* retry with buffered I/O */
+                 }
+             }
+#else
+             (void) fullpath;
+#endif
+             if (size > 0 && file->page_cache) {
+                 file->offset += size;
+                 drop_page_cache_range(file->page_cache, file->fd.plain, file->offset);
+             }
              break;
 #ifdef WITH_ZLIB
         case COMPRESSION_GZIP:
-             size = gzread(file.fd.gzip, buf, count);
+             size = gzread(file->fd.gzip, buf, count);
              break;
 #endif
         case COMPRESSION_ERROR:
@@ -181,6 +561,9 @@ static off_t hashsum_read(hashsums_file file, void *buf, size_t count) {
 static int hashsum_close(hashsums_file file) {
     switch (file.compression) {
         case COMPRESSION_PLAIN:
+             if (file.page_cache) {
+                 drop_page_cache_range(file.page_cache, file.fd.plain, file.page_cache->size);
+             }
              return close(file.fd.plain);
 #ifdef WITH_ZLIB
         case COMPRESSION_GZIP:
@@ -192,6 +575,361 @@ static int hashsum_close(hashsums_file file) {
     return -1;
 }
 
+/*
+ * Hard link cache
+ *
+ * The hashsums of files with more than one link are cached by device and
+ * inode, so that they are only read once.
+ */
+
+typedef struct hardlink_key {
+    dev_t dev;
+    ino_t ino;
+} hardlink_key;
+
+typedef struct hardlink_entry {
+    hardlink_key key;
+    off_t size;
+    struct timespec mtime;
+    struct timespec ctime;
+    md_hashsums hs;
+} hardlink_entry;
+
+static pthread_mutex_t hardlink_mutex = PTHREAD_MUTEX_INITIALIZER;
+static tree_node *hardlink_cache = NULL;
+static long hardlink_hits = 0;
+static long long hardlink_bytes_saved = 0;
+
+static int hardlink_key_cmp(const void *a, const void *b) {
+    const hardlink_key *x = a;
+    const hardlink_key *y = b;
+    if (x->dev != y->dev) {
+        return x->dev < y->dev ? -1 : 1;
+    }
+    return (x->ino > y->ino) - (x->ino < y->ino);
+}
+
+static bool hardlink_entry_matches(hardlink_entry *entry, struct stat *fs) {
+    return entry->size == fs->st_size
+        && entry->mtime.tv_sec == fs->st_mtim.tv_sec && entry->mtime.tv_nsec == fs->st_mtim.tv_nsec
+        && entry->ctime.tv_sec == fs->st_ctim.tv_sec && entry->ctime.tv_nsec == fs->st_ctim.tv_nsec;
+}
+
+/* returns true if the hashsums of attr have been found in the cache */
+bool get_hardlink_hashsums(char *fullpath, DB_ATTR_TYPE attr, struct stat *fs, md_hashsums *hs) {
+    bool found = false;
+    if (fs->st_nlink > 1) {
+        hardlink_key key = { fs->st_dev, fs->st_ino };
+        DB_ATTR_TYPE hashes = attr&get_available_hashes();
+        pthread_mutex_lock(&hardlink_mutex);
+        hardlink_entry *entry = tree_search(hardlink_cache, &key, &hardlink_key_cmp);
+        if (entry && hardlink_entry_matches(entry, fs) && (entry->hs.attrs&hashes) == hashes) {
+            *hs = entry->hs;
+            hardlink_hits++;
+            hardlink_bytes_saved += fs->st_size;
+            found = true;
+        }
+        pthread_mutex_unlock(&hardlink_mutex);
+        if (found) {
+            log_msg(LOG_LEVEL_DEBUG, "%s> use cached hashsums of hard link (inode: %llu)", fullpath, (unsigned long long) fs->st_ino);
+        }
+    }
+    return found;
+}
+
+void add_hardlink_hashsums(struct stat *fs, md_hashsums *hs) {
+    if (fs->st_nlink > 1 && hs->attrs) {
+        hardlink_key key = { fs->st_dev, fs->st_ino };
+        pthread_mutex_lock(&hardlink_mutex);
+        hardlink_entry *entry = tree_search(hardlink_cache, &key, &hardlink_key_cmp);
+        if (entry == NULL) {
+            entry = checked_malloc(sizeof(hardlink_entry)); /* not to be freed, used until exit */
+            entry->key = key;
+            hardlink_cache = tree_insert(hardlink_cache, &entry->key, entry, &hardlink_key_cmp);
+        }
+        entry->size = fs->st_size;
+        entry->mtime = fs->st_mtim;
+        entry->ctime = fs->st_ctim;
+        entry->hs = *hs;
+        pthread_mutex_unlock(&hardlink_mutex);
+    }
+}
+
+void log_hardlink_cache_stats(void) {
+    log_msg(LOG_LEVEL_INFO, "hard link cache: %ld hit(s), %lld bytes not read", hardlink_hits, hardlink_bytes_saved);
+}
+
+/* number of files hashed with a single pread() (see small_file_threshold) */
+static atomic_long small_files = 0;
+
+/* returns true if the file is hashed with a single pread() into the read buffer */
+bool is_small_file(struct stat *fs) {
+    return conf->small_file_threshold > 0 && S_ISREG(fs->st_mode)
+        && fs->st_size < conf->small_file_threshold && fs->st_size < conf->read_block_size;
+}
+
+void log_small_file_stats(void) {
+    log_msg(LOG_LEVEL_INFO, "small file fast path: %ld file(s)", atomic_load(&small_files));
+}
+
+/* returns the number of bytes read or -1 if the file has to be hashed by calc_hashsums() */
+static off_t read_small_file(small_hash_request *req, char *buf, size_t buf_size) {
+    struct stat new_fs;
+    int sres, filedes;
+
+#ifdef HAVE_O_NOATIME
+    filedes=open(req->fullpath,O_RDONLY|O_NOATIME);
+    if(filedes<0) {
+#endif
+        filedes=open(req->fullpath,O_RDONLY);
+#ifdef HAVE_O_NOATIME
+    }
+#endif
+    if (filedes==-1) {
+        return -1;
+    }
+#ifdef HAVE_STATX
+    sres=stat_masked(filedes,"",&new_fs,NULL,AT_EMPTY_PATH);
+#else
+    sres=fstat(filedes,&new_fs);
+#endif
+    off_t size = -1;
+    if (sres == 0) {
+        if(!(req->attr&ATTR(attr_rdev))) {
+            new_fs.st_rdev=0;
+        }
+        if (stat_cmp(&new_fs, req->fs, false) == RETOK) {
+            do {
+                size = pread(filedes, buf, buf_size, 0);
+            } while (size == -1 && errno == EINTR);
+            if (size != new_fs.st_size) {
+                size = -1;
+            }
+        }
+    }
+    close(filedes);
+    return size;
+}
+
+/*
+ * Calculates the hashsums of up to SMALL_FILES_BATCH_SIZE small files at once
+ * (see small_file_batch): the files are read into the read buffer of the
+ * thread and their sha256 hashsums are calculated by a single call of the
+ * multi-buffer implementation. Other hashsums are calculated per file.
+ */
+void calc_small_hashsums(small_hash_request *reqs, int n) {
+    small_hash_request *batch[SMALL_FILES_BATCH_SIZE];
+    const unsigned char *data[SMALL_FILES_BATCH_SIZE];
+    size_t lengths[SMALL_FILES_BATCH_SIZE];
+    unsigned char digests[SMALL_FILES_BATCH_SIZE][32];
+    size_t offsets[SMALL_FILES_BATCH_SIZE];
+    int num_files = 0;
+    size_t total_size = 0;
+
+    bool batching = !conf->direct_io && !conf->drop_page_cache && use_native_sha256_multi();
+    for (int i = 0 ; i < n && i < SMALL_FILES_BATCH_SIZE ; ++i) {
+        reqs[i].done = false;
+        reqs[i].hashsums.attrs = 0LLU;
+        /* hard links are left to calc_hashsums() to use the hard link cache */
+        if (batching && reqs[i].attr&ATTR(attr_sha256) && is_small_file(reqs[i].fs) && reqs[i].fs->st_nlink <= 1
+                && !(reqs[i].attr&(ATTR(attr_growing)|ATTR(attr_compressed)))) {
+            /* one more byte to detect growing files */
+            offsets[num_files] = total_size;
+            total_size += (reqs[i].fs->st_size + 1 + 63) & ~63;
+            batch[num_files++] = &reqs[i];
+        }
+    }
+    if (num_files == 0) {
+        return;
+    }
+
+    size_t buf_size;
+    char *buf = get_read_buffer(total_size - 1, false, &buf_size);
+    int num_read = 0;
+    for (int i = 0 ; i < num_files ; ++i) {
+        small_hash_request *req = batch[i];
+        size_t slot_size = req->fs->st_size + 1;
+        if (offsets[i] + slot_size > buf_size) {
+            break;
+        }
+        off_t size = read_small_file(req, buf + offsets[i], slot_size);
+        if (size < 0) {
+            continue;
+        }
+
+        DB_ATTR_TYPE other_hashes = req->attr&get_hashes(true)&~ATTR(attr_sha256);
+        if (other_hashes) {
+            struct md_container mdc;
+            mdc.todo_attr = other_hashes;
+            if (init_md(&mdc, req->fullpath) != RETOK) {
+                continue;
+            }
+            if (update_md(&mdc, buf + offsets[i], size) != RETOK) {
+                close_md(&mdc, NULL, req->fullpath);
+                continue;
+            }
+            close_md(&mdc, &req->hashsums, req->fullpath);
+        }
+        data[num_read] = (unsigned char *) buf + offsets[i];
+        lengths[num_read] = size;
+        batch[num_read++] = req;
+    }
+
+    native_hash_sha256_multi(data, lengths, num_read, digests);
+    for (int i = 0 ; i < num_read ; ++i) {
+        memcpy(batch[i]->hashsums.hashsums[hash_sha256], digests[i], 32);
+        batch[i]->hashsums.attrs |= ATTR(attr_sha256);
+        batch[i]->done = true;
+        log_msg(LOG_LEVEL_DEBUG, "%s> calculated hashsums of '%s' in a batch of %d file(s)", batch[i]->fullpath, batch[i]->fullpath, num_read);
+    }
+    atomic_fetch_add(&small_files, num_read);
+}
+
+/*
+ * Read pipeline (see pipeline_threshold)
+ *
+ * A reader thread fills PIPELINE_BUFFERS blocks in turn while the calling
+ * thread calculates the hashsums of the blocks already read.
+ */
+
+#define PIPELINE_BUFFERS 3
+
+typedef struct read_pipeline {
+    hashsums_file *file;
+    const char *fullpath;
+    size_t block_size;
+
+    char *bufs[PIPELINE_BUFFERS];
+    off_t sizes[PIPELINE_BUFFERS]; /* 0 on end of file, negative on error */
+    unsigned long produced;
+    unsigned long consumed;
+    bool holding; /* the consumer still uses the block of slot consumed */
+    bool stop;
+
+    pthread_t reader;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} read_pipeline;
+
+static void *pipeline_reader(void *arg) {
+    read_pipeline *pipeline = arg;
+    while (1) {
+        pthread_mutex_lock(&pipeline->mutex);
+        while (!pipeline->stop && pipeline->produced - pipeline->consumed == PIPELINE_BUFFERS) {
+            pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+        }
+        if (pipeline->stop) {
+            pthread_mutex_unlock(&pipeline->mutex);
+            break;
+        }
+        int slot = pipeline->produced % PIPELINE_BUFFERS;
+        pthread_mutex_unlock(&pipeline->mutex);
+
+        off_t size = hashsum_read(pipeline->file, pipeline->bufs[slot], pipeline->block_size, pipeline->fullpath);
+
+        pthread_mutex_lock(&pipeline->mutex);
+        pipeline->sizes[slot] = size;
+        pipeline->produced++;
+        pthread_cond_broadcast(&pipeline->cond);
+        pthread_mutex_unlock(&pipeline->mutex);
+        if (size <= 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/* returns false if the reader thread could not be started */
+static bool pipeline_start(read_pipeline *pipeline, hashsums_file *file, const char *fullpath) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    pipeline->file = file;
+    pipeline->fullpath = fullpath;
+    pipeline->block_size = ((conf->read_block_size + page_size - 1)/page_size)*page_size;
+    pipeline->produced = 0;
+    pipeline->consumed = 0;
+    pipeline->holding = false;
+    pipeline->stop = false;
+    pthread_mutex_init(&pipeline->mutex, NULL);
+    pthread_cond_init(&pipeline->cond, NULL);
+    for (int i = 0 ; i < PIPELINE_BUFFERS ; ++i) {
+        pipeline->bufs[i] = checked_aligned_alloc(page_size, pipeline->block_size); /* freed in pipeline_stop */
+    }
+    if (pthread_create(&pipeline->reader, NULL, &pipeline_reader, pipeline) != 0) {
+        log_msg(LOG_LEVEL_DEBUG, "%s> failed to start reader thread for '%s' (read sequentially)", fullpath, fullpath);
+        for (int i = 0 ; i < PIPELINE_BUFFERS ; ++i) {
+            free(pipeline->bufs[i]);
+        }
+        pthread_cond_destroy(&pipeline->cond);
+        pthread_mutex_destroy(&pipeline->mutex);
+        return false;
+    }
+    log_msg(LOG_LEVEL_DEBUG, "%s> read '%s' using reader thread (%d buffers of %zu bytes)", fullpath, fullpath, PIPELINE_BUFFERS, pipeline->block_size);
+    return true;
+}
+
+/* releases the previous block and returns the size of the next one (see hashsum_read) */
+static off_t pipeline_next(read_pipeline *pipeline, char **buf) {
+    pthread_mutex_lock(&pipeline->mutex);
+    if (pipeline->holding) {
+        pipeline->consumed++;
+        pipeline->holding = false;
+        pthread_cond_broadcast(&pipeline->cond);
+    }
+    while (pipeline->produced == pipeline->consumed) {
+        pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+    }
+    int slot = pipeline->consumed % PIPELINE_BUFFERS;
+    off_t size = pipeline->sizes[slot];
+    pipeline->holding = true;
+    pthread_mutex_unlock(&pipeline->mutex);
+    *buf = pipeline->bufs[slot];
+    return size;
+}
+
+static void pipeline_stop(read_pipeline *pipeline) {
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->stop = true;
+    pthread_cond_broadcast(&pipeline->cond);
+    pthread_mutex_unlock(&pipeline->mutex);
+    pthread_join(pipeline->reader, NULL);
+    for (int i = 0 ; i < PIPELINE_BUFFERS ; ++i) {
+        free(pipeline->bufs[i]);
+    }
+    pthread_cond_destroy(&pipeline->cond);
+    pthread_mutex_destroy(&pipeline->mutex);
+}
+
+/* starts the read-ahead of the first block of the file (see prefetch_files) */
+void prefetch_file(char *fullpath, struct stat *fs) {
+#ifdef HAVE_POSIX_FADVISE
+    if (!S_ISREG(fs->st_mode) || fs->st_size == 0) {
+        return;
+    }
+    int filedes;
+#ifdef HAVE_O_NOATIME
+    filedes = open(fullpath, O_RDONLY|O_NOATIME);
+    if (filedes < 0) {
+#endif
+        filedes = open(fullpath, O_RDONLY);
+#ifdef HAVE_O_NOATIME
+    }
+#endif
+    if (filedes < 0) {
+        log_msg(LOG_LEVEL_DEBUG, "%s> prefetch: open() failed for '%s': %s", fullpath, fullpath, strerror(errno));
+        return;
+    }
+    off_t length = fs->st_size < conf->read_block_size ? fs->st_size : conf->read_block_size;
+    if (posix_fadvise(filedes, 0, length, POSIX_FADV_WILLNEED) != 0) {
+        log_msg(LOG_LEVEL_DEBUG, "%s> prefetch: posix_fadvise error for '%s': %s", fullpath, fullpath, strerror(errno));
+    } else {
+        log_msg(LOG_LEVEL_DEBUG, "%s> prefetch first %lld bytes of '%s'", fullpath, (long long) length, fullpath);
+    }
+    close(filedes);
+#else
+    (void) fullpath; (void) fs;
+#endif
+}
+
 md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs, ssize_t limit_size, bool uncompress) {
     md_hashsums md_hash;
     md_hash.attrs = 0LU;
@@ -212,7 +950,11 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
             log_msg(LOG_LEVEL_WARNING, "hash calculation: open() failed for %s: %s (hashsums could not be calculated)", fullpath, strerror(errno));
             return md_hash;
         }
+#ifdef HAVE_STATX
+        sres=stat_masked(filedes,"",&new_fs,NULL,AT_EMPTY_PATH);
+#else
         sres=fstat(filedes,&new_fs);
+#endif
         if (sres != 0) {
             log_msg(LOG_LEVEL_WARNING, "hash calculation: fstat() failed for '%s': %s (hashsums could not be calculated)", fullpath, strerror(errno));
             return md_hash;
@@ -220,8 +962,9 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
         if(!(attr&ATTR(attr_rdev))) {
             new_fs.st_rdev=0;
         }
+        bool small_file = !uncompress && is_small_file(&new_fs);
 #ifdef HAVE_POSIX_FADVISE
-        if (posix_fadvise(filedes,0,new_fs.st_size,POSIX_FADV_NOREUSE)!=0) {
+        if (!small_file && posix_fadvise(filedes,0,new_fs.st_size,POSIX_FADV_NOREUSE)!=0) {
             log_msg(LOG_LEVEL_DEBUG, "%s> calc_hashsums: posix_fadvise error for '%s': %s", fullpath, fullpath, strerror(errno));
         }
 #endif
@@ -252,11 +995,78 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
             mdc.todo_attr = attr;
             if (init_md(&mdc, fullpath)==RETOK) {
                 log_msg(LOG_LEVEL_DEBUG, "%s> calculate hashes for '%s'", fullpath, fullpath);
-                buf=checked_malloc(READ_BLOCK_SIZE);
-#if READ_BLOCK_SIZE>SSIZE_MAX
-#error "READ_BLOCK_SIZE" is too large. Max value is SSIZE_MAX, and current is READ_BLOCK_SIZE
+                if (conf->hash_threads_threshold > 0 && S_ISREG(new_fs.st_mode) && new_fs.st_size >= conf->hash_threads_threshold) {
+                    start_md_threads(&mdc, fullpath);
+                }
+                size_t buf_size;
+                buf = get_read_buffer(new_fs.st_size, file.compression != COMPRESSION_PLAIN, &buf_size);
+#ifdef O_DIRECT
+                if (conf->direct_io && file.compression == COMPRESSION_PLAIN && S_ISREG(new_fs.st_mode)) {
+                    file.direct = enable_direct_io(filedes, fullpath);
+                }
 #endif
-                while ((size = hashsum_read(file,buf,READ_BLOCK_SIZE)) > 0) {
+                page_cache_state page_cache;
+                if (conf->drop_page_cache && file.compression == COMPRESSION_PLAIN && !file.direct
+                        && S_ISREG(new_fs.st_mode) && init_page_cache_state(&page_cache, filedes, new_fs.st_size, fullpath)) {
+                    file.page_cache = &page_cache;
+                }
+                if (small_file) {
+                    /* the buffer is larger than the file, so growing files are detected as well */
+                    do {
+                        size = pread(filedes, buf, buf_size, 0);
+#ifdef O_DIRECT
+                        if (size == -1 && errno == EINVAL && file.direct) {
+                            if ((file.direct = !disable_direct_io(filedes, fullpath)) == false) {
+                                errno = EINTR; /* retry with buffered I/O */
+                            }
+                        }
+#endif
+                    } while (size == -1 && errno == EINTR);
+                    if (size < 0) {
+                        log_msg(LOG_LEVEL_WARNING, "hash calculation: pread() failed for '%s': %s (hashsums could not be calculated)", fullpath, strerror(errno));
+                        hashsum_close(file);
+                        close_md(&mdc, NULL, fullpath);
+                        return md_hash;
+                    }
+                    r_size = size;
+                    if (limit_size > 0 && r_size > limit_size) {
+                        r_size = limit_size;
+                    } else if(attr&ATTR(attr_growing) && r_size > old_fs->st_size) {
+                        r_size = old_fs->st_size;
+                    }
+                    if (update_md(&mdc,buf,r_size)!=RETOK) {
+                        log_msg(LOG_LEVEL_WARNING, "hash calculation: update_md() failed for '%s' (hashsums could not be calculated)", fullpath);
+                        hashsum_close(file);
+                        close_md(&mdc, NULL, fullpath);
+                        return md_hash;
+                    }
+                    atomic_fetch_add(&small_files, 1);
+                } else if (conf->mmap_threshold > 0 && file.compression == COMPRESSION_PLAIN && !file.direct
+                        && S_ISREG(new_fs.st_mode) && new_fs.st_size >= conf->mmap_threshold
+                        /* the SIGBUS of a truncated file can only be caught in this thread */
+                        && !md_uses_threads(&mdc)) {
+                    off_t mmap_size = new_fs.st_size;
+                    if (limit_size > 0 && limit_size < mmap_size) {
+                        mmap_size = limit_size;
+                    }
+                    if (attr&ATTR(attr_growing) && old_fs->st_size < mmap_size) {
+                        mmap_size = old_fs->st_size;
+                    }
+                    log_msg(LOG_LEVEL_DEBUG, "%s> hash first %lld bytes of '%s' using mmap()", fullpath, (long long) mmap_size, fullpath);
+                    if ((r_size = mmap_update_md(&mdc, filedes, mmap_size, fullpath)) < 0
+                            || lseek(filedes, r_size, SEEK_SET) != r_size) {
+                        hashsum_close(file);
+                        close_md(&mdc, NULL, fullpath);
+                        return md_hash;
+                    }
+                }
+                read_pipeline pipeline;
+                bool pipelined = !small_file && r_size == 0 && conf->pipeline_threshold > 0
+                    && S_ISREG(new_fs.st_mode) && new_fs.st_size >= conf->pipeline_threshold
+                    && pipeline_start(&pipeline, &file, fullpath);
+                /* read the (remaining) data, e.g. appended data of non-growing files to be detected below */
+                while (!small_file && !(limit_size > 0 && r_size >= limit_size) && !(attr&ATTR(attr_growing) && r_size >= old_fs->st_size)
+                        && (size = pipelined ? pipeline_next(&pipeline, &buf) : hashsum_read(&file,buf,buf_size,fullpath)) > 0) {
 
                     off_t update_md_size;
                     if (limit_size > 0 && r_size+size > limit_size) {
@@ -269,7 +1079,9 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
 
                     if (update_md(&mdc,buf,update_md_size)!=RETOK) {
                         log_msg(LOG_LEVEL_WARNING, "hash calculation: update_md() failed for '%s' (hashsums could not be calculated)", fullpath);
-                        free(buf);
+                        if (pipelined) {
+                            pipeline_stop(&pipeline);
+                        }
                         hashsum_close(file);
                         close_md(&mdc, NULL, fullpath);
                         return md_hash;
@@ -283,6 +1095,9 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
                         break;
                     }
                 }
+                if (pipelined) {
+                    pipeline_stop(&pipeline);
+                }
                 if (uncompress == false) {
                     bool mismatch = false;
                     bool lower = false;
@@ -309,13 +1124,11 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
                                 (long long) r_size, limit_size > 0?"limited":"stat", target_size, fullpath,
                                 lower?", was file truncated while AIDE was running?":", was file growing while AIDE was running? (consider adding 'growing' attribute)"
                                );
-                        free(buf);
                         hashsum_close(file);
                         close_md(&mdc, NULL, fullpath);
                         return md_hash;
                     }
                 }
-                free(buf);
                 close_md(&mdc, &md_hash, fullpath);
                 hashsum_close(file);
                 return md_hash;
@@ -327,7 +1140,7 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
         }
 }
 
-void fs2db_line(struct stat* fs,db_line* line) {
+void fs2db_line(struct stat* fs,time_t btime,db_line* line) {
   
   /* inode is always needed for ignoring changed filename */
   line->inode=fs->st_ino;
@@ -380,6 +1193,15 @@ void fs2db_line(struct stat* fs,db_line* line) {
     line->atime=0;
   }
 
+  if(ATTR(attr_btime)&line->attr){
+    line->btime=btime;
+    if (!btime) {
+      log_msg(LOG_LEVEL_DEBUG, "%s> birth time not available", line->fullpath);
+    }
+  }else{
+    line->btime=0;
+  }
+
   if(ATTR(attr_bcount)&line->attr){
     line->bcount=fs->st_blocks;
   } else {
@@ -47,6 +47,7 @@
 #include "db_disk.h"
 #include "db_lex.h"
 #include "do_md.h"
+#include "hash_cache.h"
 #include "log.h"
 #include "progress.h"
 #include "util.h"
@@ -55,7 +56,7 @@
 /*for locale support*/
 
 void hsymlnk(db_line* line);
-void fs2db_line(struct stat* fs,db_line* line);
+void fs2db_line(struct stat* fs,time_t btime,db_line* line);
 void no_hash(db_line* line);
 
 LOG_LEVEL compare_log_level = LOG_LEVEL_COMPARE;
@@ -217,6 +218,7 @@ static DB_ATTR_TYPE get_changed_attributes(db_line* l1,db_line* l2, DB_ATTR_TYPE
     easy_growing_compare(ATTR(attr_atime),atime);
     easy_growing_compare(ATTR(attr_mtime),mtime);
     easy_growing_compare(ATTR(attr_ctime),ctime);
+    easy_compare(ATTR(attr_btime),btime);
     easy_compare(ATTR(attr_inode),inode);
     easy_compare(ATTR(attr_linkcount),nlink);
 
@@ -486,7 +488,7 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
   if (db_flags&DB_NEW) {
       db_line *new_file = node->new_data;
       if (new_file->attr&ATTR(attr_compressed)) {
-          DB_ATTR_TYPE available_hashsums = get_hashes(false);
+          DB_ATTR_TYPE available_hashsums = get_available_hashes();
           if (new_file->attr&available_hashsums) {
               if (conf->action&DO_COMPARE) {
                   log_msg(compare_log_level, "┝ '%s' has compressed attribute set, calculate uncompressed hashsums", new_file->filename);
@@ -507,6 +509,7 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
                       }
                       log_msg(compare_log_level, "│ search for original file with uncompressed hashsums of new:'%s'", new_file->filename);
 
+                      pthread_mutex_lock(&(node->parent)->mutex);
                       for(tree_node *x = tree_walk_first((node->parent)->children); x != NULL ; x = tree_walk_next(x)) {
                           moved_node = tree_get_data(x);
                           if (moved_node != node) {
@@ -531,6 +534,7 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
                           }
                           moved_node = NULL;
                       }
+                      pthread_mutex_unlock(&(node->parent)->mutex);
 
                       for (int i = 0 ; i < num_hashes ; ++i) {
                           free(new_hashsums[i]);
@@ -577,6 +581,7 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
           if( (node->parent)->checked&NODE_CHECK_INODE && node->new_data != NULL ) {
               log_msg(compare_log_level, "┝ parent directory (%s) of '%s' (inode: %li) has entries with check inode attribute set, search for source file with same inode", (node->parent)->path, (node->new_data)->filename, (node->new_data)->inode);
               seltree* moved_node = NULL;
+              pthread_mutex_lock(&(node->parent)->mutex);
               for(tree_node *x = tree_walk_first((node->parent)->children); x != NULL ; x = tree_walk_next(x)) {
                   moved_node = tree_get_data(x);
                   if (moved_node != node) {
@@ -592,6 +597,7 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
                   }
                   moved_node = NULL;
               }
+              pthread_mutex_unlock(&(node->parent)->mutex);
              if(moved_node != NULL) {
                   db_line *newData = node->new_data;
                   db_line *oldData = moved_node->old_data;
@@ -639,9 +645,14 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
   pthread_mutex_unlock(&node->mutex);
 }
 
+static pthread_mutex_t limit_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 match_result check_limit(char* filename, bool log_partial_match) {
     if(conf->limit!=NULL) {
+        /* limit_md is shared by the scan workers */
+        pthread_mutex_lock(&limit_mutex);
         int match=pcre2_match(conf->limit_crx, (PCRE2_SPTR) filename, PCRE2_ZERO_TERMINATED, 0, PCRE2_PARTIAL_SOFT, conf->limit_md, NULL);
+        pthread_mutex_unlock(&limit_mutex);
         if (match >= 0) {
             log_msg(LOG_LEVEL_TRACE, "'%s' does match limit '%s'", filename, conf->limit);
             return 0;
@@ -693,7 +704,51 @@ match_t check_rxtree(char* filename,seltree* tree, RESTRICTION_TYPE file_type, c
   return match;
 }
 
-db_line* get_file_attrs(char* filename,DB_ATTR_TYPE attr, struct stat *fs)
+/*
+ * Copies the hashsums of the old database entry of a file with trustctime
+ * attribute set to hs if its ctime, mtime, size and inode are unchanged
+ * hs: hashsums to fill or NULL (only check if the hashsums can be carried over)
+ */
+bool get_carried_over_hashsums(char *fullpath, DB_ATTR_TYPE attr, struct stat *fs, md_hashsums *hs) {
+    DB_ATTR_TYPE trusted_attrs = ATTR(attr_ctime)|ATTR(attr_mtime)|ATTR(attr_size)|ATTR(attr_inode);
+    DB_ATTR_TYPE hashes = attr&get_available_hashes();
+    bool carried_over = false;
+
+    if (!(conf->action&DO_COMPARE) || !(attr&ATTR(attr_trustctime)) || !hashes || !S_ISREG(fs->st_mode)) {
+        return false;
+    }
+    seltree *node = get_seltree_node(conf->tree, &fullpath[conf->root_prefix_length]);
+    if (node == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&node->mutex);
+    db_line *old = node->old_data;
+    if (old && (old->attr&(trusted_attrs|hashes)) == (trusted_attrs|hashes)
+            && old->ctime == fs->st_ctime && old->mtime == fs->st_mtime
+            && old->size == fs->st_size && old->inode == (long) fs->st_ino) {
+        carried_over = true;
+        for (int i = 0 ; i < num_hashes ; ++i) {
+            if (hashes&ATTR(hashsums[i].attribute) && old->hashsums[i] == NULL) {
+                carried_over = false;
+            }
+        }
+        if (carried_over && hs) {
+            for (int i = 0 ; i < num_hashes ; ++i) {
+                if (hashes&ATTR(hashsums[i].attribute)) {
+                    memcpy(hs->hashsums[i], old->hashsums[i], hashsums[i].length);
+                }
+            }
+            hs->attrs = hashes;
+            node->checked |= NODE_HASHSUMS_CARRIED_OVER;
+            log_msg(LOG_LEVEL_DEBUG, "%s> carry over hashsums of old database entry (ctime, mtime, size and inode are unchanged)", fullpath);
+        }
+    }
+    pthread_mutex_unlock(&node->mutex);
+    return carried_over;
+}
+
+/* btime: birth time (see stat_masked), hs: already calculated hashsums or NULL */
+db_line* get_file_attrs(char* filename,DB_ATTR_TYPE attr, struct stat *fs, time_t btime, md_hashsums *hs)
 {
   log_msg(LOG_LEVEL_DEBUG, "get file attributes '%s' (fullpath: '%s')", &filename[conf->root_prefix_length], filename);
   db_line* line=NULL;
@@ -759,7 +814,7 @@ db_line* get_file_attrs(char* filename,DB_ATTR_TYPE attr, struct stat *fs)
     Set normal part
   */
   
-  fs2db_line(fs,line);
+  fs2db_line(fs,btime,line);
   
   /*
     ACL stuff
@@ -786,9 +841,22 @@ db_line* get_file_attrs(char* filename,DB_ATTR_TYPE attr, struct stat *fs)
 #endif
 
   if (line->attr&get_hashes(true) && S_ISREG(fs->st_mode)) {
-    md_hashsums hs = calc_hashsums(line->fullpath, line->attr, fs, -1, false);
-    if (hs.attrs) {
-        hashsums2line(&hs,line);
+    md_hashsums calculated_hs;
+    if (hs == NULL) {
+        if (!get_carried_over_hashsums(line->fullpath, line->attr, fs, &calculated_hs)
+                && !get_hardlink_hashsums(line->fullpath, line->attr, fs, &calculated_hs)) {
+            if (!get_cached_hashsums(line->fullpath, line->attr, fs, &calculated_hs)) {
+                calculated_hs = calc_hashsums(line->fullpath, line->attr, fs, -1, false);
+            }
+            add_hardlink_hashsums(fs, &calculated_hs);
+            add_cached_hashsums(fs, &calculated_hs);
+        }
+        hs = &calculated_hs;
+    } else {
+        add_cached_hashsums(fs, hs);
+    }
+    if (hs->attrs) {
+        hashsums2line(hs,line);
     } else {
         no_hash(line);
     }
@@ -0,0 +1,509 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "hash_cache.h"
+#include "attributes.h"
+#include "hashsum.h"
+#include "log.h"
+#include "tree.h"
+#include "util.h"
+
+/*
+ * The cache file consists of a header, an open-addressing table (linear
+ * probing, at most half full) of fixed-size slots keyed by device and inode,
+ * and the digests referenced by the slots. The file is written in native
+ * byte order, the layout field changes whenever the hashsum table or the slot
+ * structure changes, so an incompatible file is ignored and rewritten.
+ *
+ * The old file is mapped read-only for lookups, all hashsums of the current
+ * run are collected in memory and written to a temporary file which finally
+ * replaces the old one.
+ */
+
+#define HASH_CACHE_MAGIC "AIDEHC01"
+#define HASH_CACHE_MIN_SLOTS 16
+
+typedef struct hash_cache_header {
+    char magic[8];
+    uint32_t layout;
+    uint32_t num_slots; /* power of 2 */
+    uint64_t num_entries;
+    uint64_t data_size;
+} hash_cache_header;
+
+typedef struct hash_cache_slot {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t size;
+    int64_t mtime_sec;
+    int64_t ctime_sec;
+    uint32_t mtime_nsec;
+    uint32_t ctime_nsec;
+    uint64_t hashes; /* 0: empty slot */
+    uint64_t offset; /* offset of the digests (in hashsums[] order) in the data area */
+} hash_cache_slot;
+
+typedef struct hash_cache_entry {
+    hash_cache_slot key;
+    unsigned char *digests;
+    size_t length;
+} hash_cache_entry;
+
+static char *cache_path = NULL;
+
+static void *cache_map = NULL;
+static size_t cache_map_size = 0;
+static const hash_cache_header *cache_header = NULL;
+static const hash_cache_slot *cache_slots = NULL;
+static const unsigned char *cache_data = NULL;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static tree_node *cache_entries = NULL;
+static bool cache_modified = false;
+
+static atomic_long cache_hits = 0;
+static atomic_llong cache_bytes_saved = 0;
+
+static uint32_t get_layout(void) {
+    /* FNV-1a */
+    uint32_t h = 2166136261u;
+    uint32_t values[3 + 2 * num_hashes];
+    int n = 0;
+    values[n++] = sizeof(hash_cache_header);
+    values[n++] = sizeof(hash_cache_slot);
+    values[n++] = num_hashes;
+    for (int i = 0 ; i < num_hashes ; ++i) {
+        values[n++] = hashsums[i].attribute;
+        values[n++] = hashsums[i].length;
+    }
+    for (int i = 0 ; i < n ; ++i) {
+        for (int j = 0 ; j < 4 ; ++j) {
+            h ^= (values[i] >> (8 * j)) & 0xff;
+            h *= 16777619u;
+        }
+    }
+    return h;
+}
+
+static uint64_t get_slot_index(uint64_t dev, uint64_t ino) {
+    /* splitmix64 finalizer */
+    uint64_t x = ino ^ (dev * 0x9e3779b97f4a7c15ULL);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static size_t get_digests_length(DB_ATTR_TYPE hashes) {
+    size_t length = 0;
+    for (int i = 0 ; i < num_hashes ; ++i) {
+        if (hashes&ATTR(hashsums[i].attribute)) {
+            length += hashsums[i].length;
+        }
+    }
+    return length;
+}
+
+static hash_cache_slot get_slot_key(struct stat *fs) {
+    hash_cache_slot key = {
+        .dev = fs->st_dev,
+        .ino = fs->st_ino,
+        .size = fs->st_size,
+        .mtime_sec = fs->st_mtim.tv_sec,
+        .ctime_sec = fs->st_ctim.tv_sec,
+        .mtime_nsec = fs->st_mtim.tv_nsec,
+        .ctime_nsec = fs->st_ctim.tv_nsec,
+        .hashes = 0,
+        .offset = 0,
+    };
+    return key;
+}
+
+static bool slot_matches(const hash_cache_slot *slot, const hash_cache_slot *key) {
+    return slot->size == key->size
+        && slot->mtime_sec == key->mtime_sec && slot->mtime_nsec == key->mtime_nsec
+        && slot->ctime_sec == key->ctime_sec && slot->ctime_nsec == key->ctime_nsec;
+}
+
+static int hash_cache_key_cmp(const void *a, const void *b) {
+    const hash_cache_slot *x = a;
+    const hash_cache_slot *y = b;
+    if (x->dev != y->dev) {
+        return x->dev < y->dev ? -1 : 1;
+    }
+    return (x->ino > y->ino) - (x->ino < y->ino);
+}
+
+/* returns the slot of the mapped cache file with the same device and inode */
+static const hash_cache_slot *find_slot(uint64_t dev, uint64_t ino) {
+    if (cache_header == NULL) {
+        return NULL;
+    }
+    uint32_t mask = cache_header->num_slots - 1;
+    uint32_t index = get_slot_index(dev, ino) & mask;
+    for (uint32_t n = 0 ; n < cache_header->num_slots ; ++n) {
+        const hash_cache_slot *slot = &cache_slots[index];
+        if (slot->hashes == 0) {
+            return NULL;
+        }
+        if (slot->dev == dev && slot->ino == ino) {
+            return slot;
+        }
+        index = (index + 1) & mask;
+    }
+    return NULL;
+}
+
+/* returns the digest of hashsum i in digests (stored in hashsums[] order) */
+static const unsigned char *get_digest(const unsigned char *digests, DB_ATTR_TYPE hashes, int i) {
+    for (int j = 0 ; j < i ; ++j) {
+        if (hashes&ATTR(hashsums[j].attribute)) {
+            digests += hashsums[j].length;
+        }
+    }
+    return digests;
+}
+
+static bool validate_cache_file(const char *path) {
+    if (cache_map_size < sizeof(hash_cache_header)) {
+        log_msg(LOG_LEVEL_WARNING, "hash cache: ignore '%s' (file is truncated)", path);
+        return false;
+    }
+    if (memcmp(cache_header->magic, HASH_CACHE_MAGIC, sizeof(cache_header->magic)) != 0
+            || cache_header->layout != get_layout()) {
+        log_msg(LOG_LEVEL_WARNING, "hash cache: ignore '%s' (unknown file format)", path);
+        return false;
+    }
+    uint32_t num_slots = cache_header->num_slots;
+    size_t available = cache_map_size - sizeof(hash_cache_header);
+    if (num_slots == 0 || (num_slots & (num_slots - 1))
+            || num_slots > available / sizeof(hash_cache_slot)
+            || cache_header->data_size != available - num_slots * sizeof(hash_cache_slot)) {
+        log_msg(LOG_LEVEL_WARNING, "hash cache: ignore '%s' (invalid table size)", path);
+        return false;
+    }
+    DB_ATTR_TYPE known_hashes = get_hashes(true);
+    uint64_t num_entries = 0;
+    for (uint32_t i = 0 ; i < num_slots ; ++i) {
+        const hash_cache_slot *slot = &cache_slots[i];
+        if (slot->hashes) {
+            if (slot->hashes&~known_hashes || slot->offset > cache_header->data_size
+                    || get_digests_length(slot->hashes) > cache_header->data_size - slot->offset) {
+                log_msg(LOG_LEVEL_WARNING, "hash cache: ignore '%s' (invalid entry)", path);
+                return false;
+            }
+            num_entries++;
+        }
+    }
+    if (num_entries != cache_header->num_entries || num_entries == num_slots) {
+        log_msg(LOG_LEVEL_WARNING, "hash cache: ignore '%s' (invalid number of entries)", path);
+        return false;
+    }
+    return true;
+}
+
+void hash_cache_open(const char *path) {
+    cache_path = checked_strdup(path); /* freed in hash_cache_close */
+
+    int fd = open(path, O_RDONLY|O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            log_msg(LOG_LEVEL_INFO, "hash cache: '%s' does not exist (yet)", path);
+        } else {
+            log_msg(LOG_LEVEL_WARNING, "hash cache: open() failed for '%s': %s", path, strerror(errno));
+        }
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        log_msg(LOG_LEVEL_WARNING, "hash cache: fstat() failed for '%s': %s", path, strerror(errno));
+    } else if (!S_ISREG(st.st_mode) || st.st_uid != geteuid() || st.st_mode&(S_IWGRP|S_IWOTH)) {
+        log_msg(LOG_LEVEL_WARNING, "hash cache: ignore '%s' (not a regular file owned and only writable by the current user)", path);
+    } else if (st.st_size > 0) {
+        cache_map_size = st.st_size;
+        cache_map = mmap(NULL, cache_map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (cache_map == MAP_FAILED) {
+            log_msg(LOG_LEVEL_WARNING, "hash cache: mmap() failed for '%s': %s", path, strerror(errno));
+            cache_map = NULL;
+            cache_map_size = 0;
+        } else {
+            cache_header = cache_map;
+            cache_slots = (const hash_cache_slot *) (cache_header + 1);
+            if (validate_cache_file(path)) {
+                cache_data = (const unsigned char *) &cache_slots[cache_header->num_slots];
+                log_msg(LOG_LEVEL_INFO, "hash cache: read %llu entries from '%s'", (unsigned long long) cache_header->num_entries, path);
+            } else {
+                munmap(cache_map, cache_map_size);
+                cache_map = NULL;
+                cache_map_size = 0;
+                cache_header = NULL;
+                cache_slots = NULL;
+            }
+        }
+    }
+    close(fd);
+}
+
+bool get_cached_hashsums(char *fullpath, DB_ATTR_TYPE attr, struct stat *fs, md_hashsums *hs) {
+    DB_ATTR_TYPE hashes = attr&get_available_hashes();
+    if (cache_header == NULL || !hashes || !S_ISREG(fs->st_mode)) {
+        return false;
+    }
+    hash_cache_slot key = get_slot_key(fs);
+    const hash_cache_slot *slot = find_slot(key.dev, key.ino);
+    if (slot == NULL || !slot_matches(slot, &key) || (slot->hashes&hashes) != hashes) {
+        return false;
+    }
+    if (hs) {
+        for (int i = 0 ; i < num_hashes ; ++i) {
+            if (hashes&ATTR(hashsums[i].attribute)) {
+                memcpy(hs->hashsums[i], get_digest(&cache_data[slot->offset], slot->hashes, i), hashsums[i].length);
+            }
+        }
+        hs->attrs = hashes;
+        cache_hits++;
+        cache_bytes_saved += fs->st_size;
+        log_msg(LOG_LEVEL_DEBUG, "%s> use hashsums from hash cache (inode: %llu)", fullpath, (unsigned long long) fs->st_ino);
+    }
+    return true;
+}
+
+void add_cached_hashsums(struct stat *fs, md_hashsums *hs) {
+    DB_ATTR_TYPE known_hashes = get_hashes(true);
+    if (cache_path == NULL || !(hs->attrs&known_hashes) || !S_ISREG(fs->st_mode)) {
+        return;
+    }
+    hash_cache_slot key = get_slot_key(fs);
+    /* keep hashsums of the old cache entry which are not requested in this run */
+    const hash_cache_slot *slot = find_slot(key.dev, key.ino);
+    if (slot && !slot_matches(slot, &key)) {
+        slot = NULL;
+    }
+    key.hashes = (hs->attrs&known_hashes) | (slot ? slot->hashes : 0);
+
+    size_t length = get_digests_length(key.hashes);
+    unsigned char *digests = checked_malloc(length); /* freed in hash_cache_close */
+    unsigned char *p = digests;
+    for (int i = 0 ; i < num_hashes ; ++i) {
+        if (key.hashes&ATTR(hashsums[i].attribute)) {
+            memcpy(p, hs->attrs&ATTR(hashsums[i].attribute) ? hs->hashsums[i]
+                    : get_digest(&cache_data[slot->offset], slot->hashes, i), hashsums[i].length);
+            p += hashsums[i].length;
+        }
+    }
+
+    pthread_mutex_lock(&cache_mutex);
+    hash_cache_entry *entry = tree_search(cache_entries, &key, &hash_cache_key_cmp);
+    if (entry == NULL) {
+        entry = checked_malloc(sizeof(hash_cache_entry)); /* freed in hash_cache_close */
+        entry->key = key;
+        entry->digests = digests;
+        entry->length = length;
+        cache_entries = tree_insert(cache_entries, &entry->key, entry, &hash_cache_key_cmp);
+        if (slot == NULL || slot->hashes != key.hashes) {
+            cache_modified = true;
+        }
+    } else if ((entry->key.hashes&key.hashes) != key.hashes) {
+        /* same file checked by different rules (hard links) */
+        free(entry->digests);
+        entry->key = key;
+        entry->digests = digests;
+        entry->length = length;
+        cache_modified = true;
+    } else {
+        free(digests);
+    }
+    pthread_mutex_unlock(&cache_mutex);
+}
+
+static void free_hash_cache_entry(void *data) {
+    hash_cache_entry *entry = data;
+    free(entry->digests);
+    free(entry);
+}
+
+static bool write_all(int fd, const void *buf, size_t count) {
+    const unsigned char *p = buf;
+    while (count > 0) {
+        ssize_t n = write(fd, p, count);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        count -= n;
+    }
+    return true;
+}
+
+static void insert_slot(hash_cache_slot *slots, uint32_t num_slots, const hash_cache_slot *key, uint64_t offset) {
+    uint32_t index = get_slot_index(key->dev, key->ino) & (num_slots - 1);
+    while (slots[index].hashes) {
+        index = (index + 1) & (num_slots - 1);
+    }
+    slots[index] = *key;
+    slots[index].offset = offset;
+}
+
+bool hash_cache_write(bool keep_unused) {
+    if (cache_path == NULL) {
+        return true;
+    }
+    uint64_t num_entries = 0;
+    uint64_t data_size = 0;
+    for (tree_node *n = tree_walk_first(cache_entries); n != NULL ; n = tree_walk_next(n)) {
+        hash_cache_entry *entry = tree_get_data(n);
+        num_entries++;
+        data_size += entry->length;
+    }
+    uint64_t num_old_entries = 0;
+    if (cache_header) {
+        for (uint32_t i = 0 ; i < cache_header->num_slots ; ++i) {
+            const hash_cache_slot *slot = &cache_slots[i];
+            if (slot->hashes && tree_search(cache_entries, (void *) slot, &hash_cache_key_cmp) == NULL) {
+                num_old_entries++;
+                if (keep_unused) {
+                    data_size += get_digests_length(slot->hashes);
+                }
+            }
+        }
+    }
+    if (!cache_modified && (keep_unused || num_old_entries == 0) && cache_header) {
+        log_msg(LOG_LEVEL_INFO, "hash cache: '%s' is unchanged", cache_path);
+        return true;
+    }
+    if (keep_unused) {
+        num_entries += num_old_entries;
+    }
+
+    uint32_t num_slots = HASH_CACHE_MIN_SLOTS;
+    while (num_slots < 2 * num_entries) {
+        if (num_slots == (UINT32_C(1) << 31)) {
+            log_msg(LOG_LEVEL_WARNING, "hash cache: too many entries (%llu), '%s' is not written", (unsigned long long) num_entries, cache_path);
+            return false;
+        }
+        num_slots <<= 1;
+    }
+    hash_cache_slot *slots = checked_calloc(num_slots, sizeof(hash_cache_slot)); /* freed below */
+    unsigned char *data = checked_malloc(data_size ? data_size : 1); /* freed below */
+    uint64_t offset = 0;
+    for (tree_node *n = tree_walk_first(cache_entries); n != NULL ; n = tree_walk_next(n)) {
+        hash_cache_entry *entry = tree_get_data(n);
+        insert_slot(slots, num_slots, &entry->key, offset);
+        memcpy(&data[offset], entry->digests, entry->length);
+        offset += entry->length;
+    }
+    if (keep_unused && cache_header) {
+        for (uint32_t i = 0 ; i < cache_header->num_slots ; ++i) {
+            const hash_cache_slot *slot = &cache_slots[i];
+            if (slot->hashes && tree_search(cache_entries, (void *) slot, &hash_cache_key_cmp) == NULL) {
+                size_t length = get_digests_length(slot->hashes);
+                insert_slot(slots, num_slots, slot, offset);
+                memcpy(&data[offset], &cache_data[slot->offset], length);
+                offset += length;
+            }
+        }
+    }
+
+    hash_cache_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HASH_CACHE_MAGIC, sizeof(header.magic));
+    header.layout = get_layout();
+    header.num_slots = num_slots;
+    header.num_entries = num_entries;
+    header.data_size = data_size;
+
+    size_t tmp_len = strlen(cache_path) + 8;
+    char *tmp_path = checked_malloc(tmp_len); /* freed below */
+    snprintf(tmp_path, tmp_len, "%s.XXXXXX", cache_path);
+
+    bool success = false;
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        log_msg(LOG_LEVEL_WARNING, "hash cache: mkstemp() failed for '%s': %s", tmp_path, strerror(errno));
+    } else {
+        if (!write_all(fd, &header, sizeof(header))
+                || !write_all(fd, slots, num_slots * sizeof(hash_cache_slot))
+                || !write_all(fd, data, data_size)) {
+            log_msg(LOG_LEVEL_WARNING, "hash cache: write() failed for '%s': %s", tmp_path, strerror(errno));
+        } else if (fsync(fd) < 0) {
+            log_msg(LOG_LEVEL_WARNING, "hash cache: fsync() failed for '%s': %s", tmp_path, strerror(errno));
+        } else {
+            success = true;
+        }
+        if (close(fd) < 0 && success) {
+            log_msg(LOG_LEVEL_WARNING, "hash cache: close() failed for '%s': %s", tmp_path, strerror(errno));
+            success = false;
+        }
+        if (success && rename(tmp_path, cache_path) < 0) {
+            log_msg(LOG_LEVEL_WARNING, "hash cache: rename() of '%s' to '%s' failed: %s", tmp_path, cache_path, strerror(errno));
+            success = false;
+        }
+        if (!success) {
+            unlink(tmp_path);
+        } else {
+            log_msg(LOG_LEVEL_INFO, "hash cache: wrote %llu entries to '%s'", (unsigned long long) num_entries, cache_path);
+        }
+    }
+    free(tmp_path);
+    free(data);
+    free(slots);
+    return success;
+}
+
+void hash_cache_close(void) {
+    if (cache_map) {
+        munmap(cache_map, cache_map_size);
+    }
+    cache_map = NULL;
+    cache_map_size = 0;
+    cache_header = NULL;
+    cache_slots = NULL;
+    cache_data = NULL;
+
+    tree_free(cache_entries, &free_hash_cache_entry);
+    cache_entries = NULL;
+    cache_modified = false;
+
+    free(cache_path);
+    cache_path = NULL;
+}
+
+void log_hash_cache_stats(void) {
+    if (cache_path) {
+        log_msg(LOG_LEVEL_INFO, "hash cache: %ld hit(s), %lld bytes not read", (long) cache_hits, (long long) cache_bytes_saved);
+    }
+}
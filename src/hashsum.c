@@ -44,6 +44,9 @@ hashsum_t hashsums[] = {
     { attr_gostr3411_94,    32 },
     { attr_stribog256,      32 },
     { attr_stribog512,      64 },
+    { attr_blake3,          32 },
+    { attr_xxh3,            8 },
+    { attr_crc32c,          4 },
 };
 
 #ifdef WITH_MHASH
@@ -65,6 +68,9 @@ int algorithms[] = { /* order must match hashsums array */
   MHASH_GOST,
   -1, /* stribog256 not available */
   -1, /* stribog512 not available */
+  NATIVE_ONLY_ALGORITHM, /* blake3 */
+  NATIVE_ONLY_ALGORITHM, /* xxh3 */
+  NATIVE_ONLY_ALGORITHM, /* crc32c */
 };
 #endif
 
@@ -83,6 +89,9 @@ int algorithms[] = { /* order must match hashsums array */
   GCRY_MD_GOSTR3411_94,
   GCRY_MD_STRIBOG256,
   GCRY_MD_STRIBOG512,
+  NATIVE_ONLY_ALGORITHM, /* blake3 */
+  NATIVE_ONLY_ALGORITHM, /* xxh3 */
+  NATIVE_ONLY_ALGORITHM, /* crc32c */
 };
 #endif
 
@@ -99,3 +108,18 @@ DB_ATTR_TYPE get_hashes(bool include_unsupported) {
     }
     return attr;
 }
+
+DB_ATTR_TYPE get_available_hashes(void) {
+    DB_ATTR_TYPE attr = get_hashes(false);
+#ifdef WITH_GCRYPT
+    if (gcry_fips_mode_active()) {
+        return attr;
+    }
+#endif
+    for (int i = 0; i < num_hashes; ++i) {
+        if (algorithms[i] == NATIVE_ONLY_ALGORITHM) {
+            attr |= ATTR(hashsums[i].attribute);
+        }
+    }
+    return attr;
+}
@@ -20,9 +20,12 @@
  */
 
 #include "config.h"
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include "aide.h"
 #include "attributes.h"
 #include "db_line.h"
 #include "db_config.h"
@@ -30,6 +33,7 @@
 #include "hashsum.h"
 #include "log.h"
 #include "md.h"
+#include "native_hash.h"
 #include "util.h"
 
 #ifdef WITH_MHASH
@@ -41,6 +45,179 @@
 #include "errorcodes.h"
 #endif
 
+/*
+  Hashing threads (see hash_threads_threshold)
+
+  Every hashsum is calculated by its own thread over the same (read-only)
+  data, update_md() returns after all threads have processed the data.
+ */
+
+struct md_thread {
+    pthread_t thread;
+    HASHSUM hashsum;
+    struct md_threads *threads;
+};
+
+typedef struct md_threads {
+    struct md_container *md;
+    int num_threads;
+    struct md_thread thread[num_hashes];
+#ifdef WITH_GCRYPT
+    gcry_md_hd_t mdh[num_hashes];
+#endif
+
+    void *data;
+    ssize_t size;
+    unsigned long generation;
+    int pending;
+    bool stop;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+} md_threads;
+
+static void *md_thread(void *arg) {
+    struct md_thread *thread = arg;
+    md_threads *threads = thread->threads;
+    unsigned long generation = 0;
+    while (1) {
+        pthread_mutex_lock(&threads->mutex);
+        while (!threads->stop && threads->generation == generation) {
+            pthread_cond_wait(&threads->work_cond, &threads->mutex);
+        }
+        if (threads->stop) {
+            pthread_mutex_unlock(&threads->mutex);
+            break;
+        }
+        generation = threads->generation;
+        void *data = threads->data;
+        ssize_t size = threads->size;
+        pthread_mutex_unlock(&threads->mutex);
+
+        if (threads->md->native_attr&ATTR(hashsums[thread->hashsum].attribute)) {
+            native_hash_update(&threads->md->native[thread->hashsum], data, size);
+        } else {
+#ifdef WITH_MHASH
+            mhash(threads->md->mhash_mdh[thread->hashsum], data, size);
+#endif
+#ifdef WITH_GCRYPT
+            gcry_md_write(threads->mdh[thread->hashsum], data, size);
+#endif
+        }
+
+        pthread_mutex_lock(&threads->mutex);
+        if (--threads->pending == 0) {
+            pthread_cond_signal(&threads->done_cond);
+        }
+        pthread_mutex_unlock(&threads->mutex);
+    }
+    return NULL;
+}
+
+static void stop_md_threads(md_threads *threads) {
+    pthread_mutex_lock(&threads->mutex);
+    threads->stop = true;
+    pthread_cond_broadcast(&threads->work_cond);
+    pthread_mutex_unlock(&threads->mutex);
+    for (int i = 0 ; i < threads->num_threads ; ++i) {
+        pthread_join(threads->thread[i].thread, NULL);
+    }
+    pthread_cond_destroy(&threads->done_cond);
+    pthread_cond_destroy(&threads->work_cond);
+    pthread_mutex_destroy(&threads->mutex);
+}
+
+/*
+  Start one hashing thread per hashsum to be calculated,
+  call this after init_md() and before the first update_md().
+ */
+
+void start_md_threads(struct md_container* md, const char *filename) {
+    int num_threads = 0;
+    for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+        if (md->calc_attr&ATTR(hashsums[i].attribute)) {
+            num_threads++;
+        }
+    }
+    if (num_threads < 2) {
+        return;
+    }
+
+    md_threads *threads = checked_malloc(sizeof(md_threads)); /* freed in close_md */
+    threads->md = md;
+    threads->num_threads = 0;
+    threads->data = NULL;
+    threads->size = 0;
+    threads->generation = 0;
+    threads->pending = 0;
+    threads->stop = false;
+    pthread_mutex_init(&threads->mutex, NULL);
+    pthread_cond_init(&threads->work_cond, NULL);
+    pthread_cond_init(&threads->done_cond, NULL);
+
+    for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+#ifdef WITH_GCRYPT
+        threads->mdh[i] = NULL;
+#endif
+        if (md->calc_attr&ATTR(hashsums[i].attribute)) {
+#ifdef WITH_GCRYPT
+            if (!(md->native_attr&ATTR(hashsums[i].attribute))
+                    && gcry_md_open(&threads->mdh[i], algorithms[i], 0) != GPG_ERR_NO_ERROR) {
+                log_msg(LOG_LEVEL_DEBUG, "%s> gcry_md_open (%s) failed for '%s' (calculate hashsums sequentially)", filename, attributes[hashsums[i].attribute].db_name, filename);
+                break;
+            }
+#endif
+            struct md_thread *thread = &threads->thread[threads->num_threads];
+            thread->hashsum = i;
+            thread->threads = threads;
+            if (pthread_create(&thread->thread, NULL, &md_thread, thread) != 0) {
+                log_msg(LOG_LEVEL_DEBUG, "%s> failed to start hashing thread (%s) for '%s' (calculate hashsums sequentially)", filename, attributes[hashsums[i].attribute].db_name, filename);
+                break;
+            }
+            threads->num_threads++;
+        }
+    }
+    if (threads->num_threads < num_threads) {
+        stop_md_threads(threads);
+#ifdef WITH_GCRYPT
+        for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+            if (threads->mdh[i]) {
+                gcry_md_close(threads->mdh[i]);
+            }
+        }
+#endif
+        free(threads);
+        return;
+    }
+    md->threads = threads;
+    log_msg(LOG_LEVEL_DEBUG, "%s> started %d hashing threads for '%s'", filename, num_threads, filename);
+}
+
+bool md_uses_threads(struct md_container* md) {
+    return md->threads != NULL || (md->native_attr&ATTR(attr_blake3) && conf->blake3_threads > 1);
+}
+
+static bool native_hash_allowed(HASHSUM i) {
+    if (!native_hash_available(i) || (!conf->native_hashsums && algorithms[i] != NATIVE_ONLY_ALGORITHM)) {
+        return false;
+    }
+#ifdef WITH_GCRYPT
+    if (gcry_fips_mode_active()) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool use_native_hash(HASHSUM i) {
+    return native_hash_allowed(i) && (algorithms[i] == NATIVE_ONLY_ALGORITHM || native_hash_faster(i));
+}
+
+bool use_native_sha256_multi(void) {
+    return native_hash_allowed(hash_sha256) && (native_hash_sha256_multi_buffer() || native_hash_faster(hash_sha256));
+}
+
 /*
   Initialise md_container according its todo_attr field
  */
@@ -57,10 +234,21 @@ int init_md(struct md_container* md, const char *filename) {
     We don't have calculator for this yet :)
   */
   md->calc_attr=0;
+  md->native_attr=0;
+  md->threads=NULL;
+  for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+      DB_ATTR_TYPE h = ATTR(hashsums[i].attribute);
+      if (h&md->todo_attr && use_native_hash(i)) {
+          native_hash_init(&md->native[i], i);
+          native_hash_set_threads(&md->native[i], (int) conf->blake3_threads);
+          md->native_attr|=h;
+          md->calc_attr|=h;
+      }
+  }
 #ifdef WITH_MHASH
    for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
        DB_ATTR_TYPE h = ATTR(hashsums[i].attribute);
-       if (h&md->todo_attr) {
+       if (h&md->todo_attr&~md->native_attr) {
            md->mhash_mdh[i]=mhash_init(algorithms[i]);
            if (md->mhash_mdh[i]!=MHASH_FAILED) {
                md->calc_attr|=h;
@@ -81,7 +269,7 @@ int init_md(struct md_container* md, const char *filename) {
 
    for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
         DB_ATTR_TYPE h = ATTR(hashsums[i].attribute);
-            if (h&md->todo_attr) {
+            if (h&md->todo_attr&~md->native_attr) {
                 if(gcry_md_enable(md->mdh,algorithms[i])==GPG_ERR_NO_ERROR){
                     md->calc_attr|=h;
                 } else {
@@ -111,6 +299,26 @@ int update_md(struct md_container* md,void* data,ssize_t size) {
   }
 #endif
 
+  if (md->threads) {
+      md_threads *threads = md->threads;
+      pthread_mutex_lock(&threads->mutex);
+      threads->data = data;
+      threads->size = size;
+      threads->pending = threads->num_threads;
+      threads->generation++;
+      pthread_cond_broadcast(&threads->work_cond);
+      while (threads->pending > 0) {
+          pthread_cond_wait(&threads->done_cond, &threads->mutex);
+      }
+      pthread_mutex_unlock(&threads->mutex);
+      return RETOK;
+  }
+
+  for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+      if (md->native_attr&ATTR(hashsums[i].attribute)) {
+          native_hash_update(&md->native[i], data, size);
+      }
+  }
 #ifdef WITH_MHASH
   for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
       if(md->mhash_mdh[i] != MHASH_FAILED){
@@ -136,6 +344,11 @@ int close_md(struct md_container* md, md_hashsums * hs, const char *filename) {
   }
 #endif
   log_msg(LOG_LEVEL_DEBUG, "%s> free md_container (%p)", filename, (void*) md);
+  md_threads *threads = md->threads;
+  if (threads) {
+      stop_md_threads(threads);
+      md->threads = NULL;
+  }
 #ifdef WITH_MHASH
   for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
       if(md->mhash_mdh[i] != MHASH_FAILED){
@@ -148,13 +361,20 @@ int close_md(struct md_container* md, md_hashsums * hs, const char *filename) {
 
   if (hs) {
       for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
-          if (md->calc_attr&ATTR(hashsums[i].attribute)) {
-              memcpy(hs->hashsums[i],gcry_md_read(md->mdh, algorithms[i]), hashsums[i].length);
+          if (md->calc_attr&~md->native_attr&ATTR(hashsums[i].attribute)) {
+              memcpy(hs->hashsums[i],gcry_md_read(threads?threads->mdh[i]:md->mdh, algorithms[i]), hashsums[i].length);
           }
       }
   }
 
   gcry_md_reset(md->mdh);
+  if (threads) {
+      for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+          if (threads->mdh[i]) {
+              gcry_md_close(threads->mdh[i]);
+          }
+      }
+  }
 #endif  
 
 #ifdef WITH_MHASH
@@ -164,9 +384,16 @@ int close_md(struct md_container* md, md_hashsums * hs, const char *filename) {
       }
   }
 #endif
+  for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+      if (md->native_attr&ATTR(hashsums[i].attribute)) {
+          unsigned char unused[HASHSUM_MAX_LENGTH];
+          native_hash_final(&md->native[i], hs?hs->hashsums[i]:unused);
+      }
+  }
   if (hs) {
       hs->attrs = md->calc_attr;
   }
+  free(threads);
   return RETOK;
 }
 
@@ -0,0 +1,1467 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define NATIVE_HASH_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#include "hashsum.h"
+#include "log.h"
+#include "native_hash.h"
+#include "util.h"
+
+/*
+ * Built-in hashsum implementations
+ *
+ * The block functions are selected once at runtime: SHA-1 and SHA-256 use
+ * the SHA extensions (SHA-NI) of x86 CPUs if available, everything else
+ * falls back to portable C. Without SHA-NI, independent SHA-256 messages
+ * are hashed 8 at once using AVX2 if available. BLAKE3 hashes 8 chunks at
+ * once and XXH3 accumulates its stripes using AVX2 if available, CRC-32C uses
+ * the SSE4.2 crc32 instruction if available.
+ */
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t sha256_h[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint64_t sha512_k[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+static const uint64_t sha512_h[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static const uint32_t sha1_h[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32-(n))))
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32-(n))))
+#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64-(n))))
+#define ROTL64(x, n) (((x) << (n)) | ((x) >> (64-(n))))
+
+static inline uint32_t load_be32(const unsigned char *p) {
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | (uint32_t) p[3];
+}
+
+static inline uint64_t load_be64(const unsigned char *p) {
+    return (uint64_t) load_be32(p) << 32 | load_be32(p+4);
+}
+
+static inline uint32_t load_le32(const unsigned char *p) {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline uint64_t load_le64(const unsigned char *p) {
+    return (uint64_t) load_le32(p) | (uint64_t) load_le32(p+4) << 32;
+}
+
+static inline void store_be32(unsigned char *p, uint32_t v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static inline void store_be64(unsigned char *p, uint64_t v) {
+    store_be32(p, v >> 32);
+    store_be32(p+4, v);
+}
+
+/* portable C implementations */
+
+static void sha1_blocks_c(uint32_t state[5], const unsigned char *data, size_t blocks) {
+    while (blocks--) {
+        uint32_t w[80];
+        for (int t = 0 ; t < 16 ; ++t) {
+            w[t] = load_be32(data + 4*t);
+        }
+        for (int t = 16 ; t < 80 ; ++t) {
+            w[t] = ROTL32(w[t-3] ^ w[t-8] ^ w[t-14] ^ w[t-16], 1);
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for (int t = 0 ; t < 80 ; ++t) {
+            uint32_t f, k;
+            if (t < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5a827999;
+            } else if (t < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            } else if (t < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            uint32_t tmp = ROTL32(a, 5) + f + e + k + w[t];
+            e = d; d = c; c = ROTL32(b, 30); b = a; a = tmp;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d; state[4] += e;
+        data += 64;
+    }
+}
+
+static void sha256_blocks_c(uint32_t state[8], const unsigned char *data, size_t blocks) {
+    while (blocks--) {
+        uint32_t w[64];
+        for (int t = 0 ; t < 16 ; ++t) {
+            w[t] = load_be32(data + 4*t);
+        }
+        for (int t = 16 ; t < 64 ; ++t) {
+            uint32_t s0 = ROTR32(w[t-15], 7) ^ ROTR32(w[t-15], 18) ^ (w[t-15] >> 3);
+            uint32_t s1 = ROTR32(w[t-2], 17) ^ ROTR32(w[t-2], 19) ^ (w[t-2] >> 10);
+            w[t] = w[t-16] + s0 + w[t-7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int t = 0 ; t < 64 ; ++t) {
+            uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[t] + w[t];
+            uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        data += 64;
+    }
+}
+
+static void sha512_blocks_c(uint64_t state[8], const unsigned char *data, size_t blocks) {
+    while (blocks--) {
+        uint64_t w[80];
+        for (int t = 0 ; t < 16 ; ++t) {
+            w[t] = load_be64(data + 8*t);
+        }
+        for (int t = 16 ; t < 80 ; ++t) {
+            uint64_t s0 = ROTR64(w[t-15], 1) ^ ROTR64(w[t-15], 8) ^ (w[t-15] >> 7);
+            uint64_t s1 = ROTR64(w[t-2], 19) ^ ROTR64(w[t-2], 61) ^ (w[t-2] >> 6);
+            w[t] = w[t-16] + s0 + w[t-7] + s1;
+        }
+        uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int t = 0 ; t < 80 ; ++t) {
+            uint64_t t1 = h + (ROTR64(e, 14) ^ ROTR64(e, 18) ^ ROTR64(e, 41)) + ((e & f) ^ (~e & g)) + sha512_k[t] + w[t];
+            uint64_t t2 = (ROTR64(a, 28) ^ ROTR64(a, 34) ^ ROTR64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        data += 128;
+    }
+}
+
+/* CRC-32 (ISO 3309, as GCRY_MD_CRC32) and CRC-32C (Castagnoli), slicing-by-8 */
+
+static uint32_t crc32_table[8][256];
+static uint32_t crc32c_table[8][256];
+
+static void init_crc_table(uint32_t table[8][256], uint32_t polynomial) {
+    for (uint32_t i = 0 ; i < 256 ; ++i) {
+        uint32_t crc = i;
+        for (int j = 0 ; j < 8 ; ++j) {
+            crc = (crc >> 1) ^ (polynomial & -(crc & 1));
+        }
+        table[0][i] = crc;
+    }
+    for (uint32_t i = 0 ; i < 256 ; ++i) {
+        for (int j = 1 ; j < 8 ; ++j) {
+            table[j][i] = (table[j-1][i] >> 8) ^ table[0][table[j-1][i] & 0xff];
+        }
+    }
+}
+
+static uint32_t crc_update(uint32_t table[8][256], uint32_t crc, const unsigned char *data, size_t length) {
+    while (length >= 8) {
+        uint32_t lo = crc ^ ((uint32_t) data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24);
+        crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff]
+            ^ table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24]
+            ^ table[3][data[4]] ^ table[2][data[5]]
+            ^ table[1][data[6]] ^ table[0][data[7]];
+        data += 8;
+        length -= 8;
+    }
+    while (length--) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xff];
+    }
+    return crc;
+}
+
+static uint32_t crc32c_update_c(uint32_t crc, const unsigned char *data, size_t length) {
+    return crc_update(crc32c_table, crc, data, length);
+}
+
+/* XXH3 (64 bit, default secret, seed 0), portable C */
+
+#define XXH_PRIME32_1 0x9E3779B1U
+#define XXH_PRIME32_2 0x85EBCA77U
+#define XXH_PRIME32_3 0xC2B2AE3DU
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define XXH3_STRIPE_LEN 64
+#define XXH3_SECRET_SIZE 192
+#define XXH3_STRIPES_PER_BLOCK ((XXH3_SECRET_SIZE - XXH3_STRIPE_LEN) / 8)
+#define XXH3_BUFFER_SIZE 256
+
+static const unsigned char xxh3_secret[XXH3_SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static inline uint64_t xxh3_mul128_fold64(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = (unsigned __int128) a * b;
+    return (uint64_t) product ^ (uint64_t) (product >> 64);
+#else
+    uint64_t lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+    uint64_t hi_lo = (a >> 32) * (b & 0xffffffff);
+    uint64_t lo_hi = (a & 0xffffffff) * (b >> 32);
+    uint64_t hi_hi = (a >> 32) * (b >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lower = (cross << 32) | (lo_lo & 0xffffffff);
+    return lower ^ upper;
+#endif
+}
+
+static inline uint64_t xxh64_avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    return h ^ (h >> 32);
+}
+
+static inline uint64_t xxh3_avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    return h ^ (h >> 32);
+}
+
+static inline uint64_t xxh3_mix16(const unsigned char *input, const unsigned char *secret) {
+    return xxh3_mul128_fold64(load_le64(input) ^ load_le64(secret), load_le64(input+8) ^ load_le64(secret+8));
+}
+
+/* hashsum of inputs up to 240 bytes */
+static uint64_t xxh3_short(const unsigned char *input, size_t length) {
+    const unsigned char *secret = xxh3_secret;
+    if (length == 0) {
+        return xxh64_avalanche(load_le64(secret+56) ^ load_le64(secret+64));
+    }
+    if (length <= 3) {
+        uint32_t combined = (uint32_t) input[length-1] | (uint32_t) length << 8
+            | (uint32_t) input[0] << 16 | (uint32_t) input[length>>1] << 24;
+        return xxh64_avalanche(combined ^ (uint64_t) (load_le32(secret) ^ load_le32(secret+4)));
+    }
+    if (length <= 8) {
+        uint64_t keyed = ((uint64_t) load_le32(input+length-4) + ((uint64_t) load_le32(input) << 32))
+            ^ (load_le64(secret+8) ^ load_le64(secret+16));
+        keyed ^= ROTL64(keyed, 49) ^ ROTL64(keyed, 24);
+        keyed *= 0x9FB21C651E98DF25ULL;
+        keyed ^= (keyed >> 35) + length;
+        keyed *= 0x9FB21C651E98DF25ULL;
+        return keyed ^ (keyed >> 28);
+    }
+    if (length <= 16) {
+        uint64_t lo = load_le64(input) ^ (load_le64(secret+24) ^ load_le64(secret+32));
+        uint64_t hi = load_le64(input+length-8) ^ (load_le64(secret+40) ^ load_le64(secret+48));
+        return xxh3_avalanche(length + __builtin_bswap64(lo) + hi + xxh3_mul128_fold64(lo, hi));
+    }
+    uint64_t acc = length * XXH_PRIME64_1;
+    if (length <= 128) {
+        if (length > 32) {
+            if (length > 64) {
+                if (length > 96) {
+                    acc += xxh3_mix16(input+48, secret+96);
+                    acc += xxh3_mix16(input+length-64, secret+112);
+                }
+                acc += xxh3_mix16(input+32, secret+64);
+                acc += xxh3_mix16(input+length-48, secret+80);
+            }
+            acc += xxh3_mix16(input+16, secret+32);
+            acc += xxh3_mix16(input+length-32, secret+48);
+        }
+        acc += xxh3_mix16(input, secret);
+        acc += xxh3_mix16(input+length-16, secret+16);
+        return xxh3_avalanche(acc);
+    }
+    for (size_t i = 0 ; i < 8 ; ++i) {
+        acc += xxh3_mix16(input+16*i, secret+16*i);
+    }
+    acc = xxh3_avalanche(acc);
+    for (size_t i = 8 ; i < length/16 ; ++i) {
+        acc += xxh3_mix16(input+16*i, secret+16*(i-8)+3);
+    }
+    acc += xxh3_mix16(input+length-16, secret+136-17); /* minimum secret size - last round offset */
+    return xxh3_avalanche(acc);
+}
+
+static void xxh3_accumulate_c(uint64_t acc[8], const unsigned char *input, const unsigned char *secret, size_t stripes) {
+    for (size_t n = 0 ; n < stripes ; ++n) {
+        const unsigned char *stripe = input + n*XXH3_STRIPE_LEN;
+        const unsigned char *key = secret + n*8;
+        for (int i = 0 ; i < 8 ; ++i) {
+            uint64_t data = load_le64(stripe + 8*i);
+            uint64_t data_key = data ^ load_le64(key + 8*i);
+            acc[i^1] += data;
+            acc[i] += (data_key & 0xffffffff) * (data_key >> 32);
+        }
+    }
+}
+
+static void xxh3_scramble_c(uint64_t acc[8], const unsigned char *secret) {
+    for (int i = 0 ; i < 8 ; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= load_le64(secret + 8*i);
+        acc[i] = a * XXH_PRIME32_1;
+    }
+}
+
+/* BLAKE3 (compression function, portable C) */
+
+#define BLAKE3_BLOCK_LEN 64
+#define BLAKE3_CHUNK_LEN 1024
+#define BLAKE3_MAX_DEPTH 54
+
+#define BLAKE3_CHUNK_START 1
+#define BLAKE3_CHUNK_END 2
+#define BLAKE3_PARENT 4
+#define BLAKE3_ROOT 8
+
+static const uint8_t blake3_schedule[7][16] = {
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+    { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+    { 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+    { 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+    { 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+    { 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+    { 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 },
+};
+
+#define BLAKE3_G(a, b, c, d, x, y) \
+    v[a] = v[a] + v[b] + (x); v[d] = ROTR32(v[d] ^ v[a], 16); \
+    v[c] = v[c] + v[d]; v[b] = ROTR32(v[b] ^ v[c], 12); \
+    v[a] = v[a] + v[b] + (y); v[d] = ROTR32(v[d] ^ v[a], 8); \
+    v[c] = v[c] + v[d]; v[b] = ROTR32(v[b] ^ v[c], 7);
+
+/* compresses a block into the chaining value cv */
+static void blake3_compress(uint32_t cv[8], const unsigned char block[BLAKE3_BLOCK_LEN], uint64_t counter, uint32_t block_len, uint32_t flags) {
+    uint32_t m[16];
+    for (int i = 0 ; i < 16 ; ++i) {
+        m[i] = load_le32(block + 4*i);
+    }
+    uint32_t v[16] = {
+        cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+        sha256_h[0], sha256_h[1], sha256_h[2], sha256_h[3],
+        (uint32_t) counter, (uint32_t) (counter >> 32), block_len, flags,
+    };
+    for (int r = 0 ; r < 7 ; ++r) {
+        const uint8_t *s = blake3_schedule[r];
+        BLAKE3_G(0, 4,  8, 12, m[s[0]],  m[s[1]])
+        BLAKE3_G(1, 5,  9, 13, m[s[2]],  m[s[3]])
+        BLAKE3_G(2, 6, 10, 14, m[s[4]],  m[s[5]])
+        BLAKE3_G(3, 7, 11, 15, m[s[6]],  m[s[7]])
+        BLAKE3_G(0, 5, 10, 15, m[s[8]],  m[s[9]])
+        BLAKE3_G(1, 6, 11, 12, m[s[10]], m[s[11]])
+        BLAKE3_G(2, 7,  8, 13, m[s[12]], m[s[13]])
+        BLAKE3_G(3, 4,  9, 14, m[s[14]], m[s[15]])
+    }
+    for (int i = 0 ; i < 8 ; ++i) {
+        cv[i] = v[i] ^ v[i+8];
+    }
+}
+
+/* chaining value of a complete chunk */
+static void blake3_chunk_cv_c(const unsigned char *chunk, uint64_t counter, uint32_t cv[8]) {
+    memcpy(cv, sha256_h, 32); /* BLAKE3 uses the SHA-256 IV */
+    for (int b = 0 ; b < BLAKE3_CHUNK_LEN/BLAKE3_BLOCK_LEN ; ++b) {
+        uint32_t flags = (b == 0 ? BLAKE3_CHUNK_START : 0) | (b == BLAKE3_CHUNK_LEN/BLAKE3_BLOCK_LEN - 1 ? BLAKE3_CHUNK_END : 0);
+        blake3_compress(cv, chunk + b*BLAKE3_BLOCK_LEN, counter, BLAKE3_BLOCK_LEN, flags);
+    }
+}
+
+static void blake3_parent_cv(const uint32_t left[8], const uint32_t right[8], uint32_t flags, uint32_t cv[8]) {
+    unsigned char block[BLAKE3_BLOCK_LEN];
+    for (int i = 0 ; i < 8 ; ++i) {
+        uint32_t l = left[i], r = right[i];
+        block[4*i] = l; block[4*i+1] = l >> 8; block[4*i+2] = l >> 16; block[4*i+3] = l >> 24;
+        block[32+4*i] = r; block[32+4*i+1] = r >> 8; block[32+4*i+2] = r >> 16; block[32+4*i+3] = r >> 24;
+    }
+    memcpy(cv, sha256_h, 32);
+    blake3_compress(cv, block, 0, BLAKE3_BLOCK_LEN, BLAKE3_PARENT|flags);
+}
+
+#ifdef NATIVE_HASH_X86
+
+/* BLAKE3 using AVX2 (8 chunks in parallel) */
+
+#define BLAKE3_ROTR256(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32-(n)))
+
+#define BLAKE3_G8(a, b, c, d, x, y) \
+    v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), x); v[d] = BLAKE3_ROTR256(_mm256_xor_si256(v[d], v[a]), 16); \
+    v[c] = _mm256_add_epi32(v[c], v[d]); v[b] = BLAKE3_ROTR256(_mm256_xor_si256(v[b], v[c]), 12); \
+    v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), y); v[d] = BLAKE3_ROTR256(_mm256_xor_si256(v[d], v[a]), 8); \
+    v[c] = _mm256_add_epi32(v[c], v[d]); v[b] = BLAKE3_ROTR256(_mm256_xor_si256(v[b], v[c]), 7);
+
+__attribute__((target("avx2")))
+static void blake3_hash8_avx2(const unsigned char *chunks, uint64_t counter, uint32_t cvs[8][8]) {
+    __m256i h[8];
+    uint32_t counter_lo[8], counter_hi[8];
+    for (int i = 0 ; i < 8 ; ++i) {
+        h[i] = _mm256_set1_epi32(sha256_h[i]);
+        counter_lo[i] = (uint32_t) (counter + i);
+        counter_hi[i] = (uint32_t) ((counter + i) >> 32);
+    }
+    __m256i ctr_lo = _mm256_loadu_si256((const __m256i *) counter_lo);
+    __m256i ctr_hi = _mm256_loadu_si256((const __m256i *) counter_hi);
+
+    for (int b = 0 ; b < BLAKE3_CHUNK_LEN/BLAKE3_BLOCK_LEN ; ++b) {
+        __m256i m[16];
+        const unsigned char *block = chunks + b*BLAKE3_BLOCK_LEN;
+        for (int w = 0 ; w < 16 ; ++w) {
+            m[w] = _mm256_setr_epi32(load_le32(block+4*w), load_le32(block+BLAKE3_CHUNK_LEN+4*w),
+                    load_le32(block+2*BLAKE3_CHUNK_LEN+4*w), load_le32(block+3*BLAKE3_CHUNK_LEN+4*w),
+                    load_le32(block+4*BLAKE3_CHUNK_LEN+4*w), load_le32(block+5*BLAKE3_CHUNK_LEN+4*w),
+                    load_le32(block+6*BLAKE3_CHUNK_LEN+4*w), load_le32(block+7*BLAKE3_CHUNK_LEN+4*w));
+        }
+        uint32_t flags = (b == 0 ? BLAKE3_CHUNK_START : 0) | (b == BLAKE3_CHUNK_LEN/BLAKE3_BLOCK_LEN - 1 ? BLAKE3_CHUNK_END : 0);
+        __m256i v[16] = {
+            h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+            _mm256_set1_epi32(sha256_h[0]), _mm256_set1_epi32(sha256_h[1]),
+            _mm256_set1_epi32(sha256_h[2]), _mm256_set1_epi32(sha256_h[3]),
+            ctr_lo, ctr_hi, _mm256_set1_epi32(BLAKE3_BLOCK_LEN), _mm256_set1_epi32(flags),
+        };
+        for (int r = 0 ; r < 7 ; ++r) {
+            const uint8_t *s = blake3_schedule[r];
+            BLAKE3_G8(0, 4,  8, 12, m[s[0]],  m[s[1]])
+            BLAKE3_G8(1, 5,  9, 13, m[s[2]],  m[s[3]])
+            BLAKE3_G8(2, 6, 10, 14, m[s[4]],  m[s[5]])
+            BLAKE3_G8(3, 7, 11, 15, m[s[6]],  m[s[7]])
+            BLAKE3_G8(0, 5, 10, 15, m[s[8]],  m[s[9]])
+            BLAKE3_G8(1, 6, 11, 12, m[s[10]], m[s[11]])
+            BLAKE3_G8(2, 7,  8, 13, m[s[12]], m[s[13]])
+            BLAKE3_G8(3, 4,  9, 14, m[s[14]], m[s[15]])
+        }
+        for (int i = 0 ; i < 8 ; ++i) {
+            h[i] = _mm256_xor_si256(v[i], v[i+8]);
+        }
+    }
+
+    uint32_t out[8][8] __attribute__((aligned(32)));
+    for (int i = 0 ; i < 8 ; ++i) {
+        _mm256_store_si256((__m256i *) out[i], h[i]);
+    }
+    for (int l = 0 ; l < 8 ; ++l) {
+        for (int i = 0 ; i < 8 ; ++i) {
+            cvs[l][i] = out[i][l];
+        }
+    }
+}
+
+/* SHA extensions (SHA-NI) */
+
+#define SHA1_NI_ROUNDS(i, e0, e1, m0, m1, m2, m3) \
+    e0 = (i) == 0 ? _mm_add_epi32(e0, m0) : _mm_sha1nexte_epu32(e0, m0); \
+    e1 = abcd; \
+    if ((i) >= 3 && (i) <= 18) { m1 = _mm_sha1msg2_epu32(m1, m0); } \
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, (i)/5); \
+    if ((i) >= 1 && (i) <= 16) { m3 = _mm_sha1msg1_epu32(m3, m0); } \
+    if ((i) >= 2 && (i) <= 17) { m2 = _mm_xor_si128(m2, m0); }
+
+__attribute__((target("sha,sse4.1")))
+static void sha1_blocks_ni(uint32_t state[5], const unsigned char *data, size_t blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0x1b);
+    __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+    __m128i e1;
+
+    while (blocks--) {
+        __m128i abcd_save = abcd;
+        __m128i e0_save = e0;
+        __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data)), mask);
+        __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data+16)), mask);
+        __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data+32)), mask);
+        __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data+48)), mask);
+
+        SHA1_NI_ROUNDS( 0, e0, e1, m0, m1, m2, m3)
+        SHA1_NI_ROUNDS( 1, e1, e0, m1, m2, m3, m0)
+        SHA1_NI_ROUNDS( 2, e0, e1, m2, m3, m0, m1)
+        SHA1_NI_ROUNDS( 3, e1, e0, m3, m0, m1, m2)
+        SHA1_NI_ROUNDS( 4, e0, e1, m0, m1, m2, m3)
+        SHA1_NI_ROUNDS( 5, e1, e0, m1, m2, m3, m0)
+        SHA1_NI_ROUNDS( 6, e0, e1, m2, m3, m0, m1)
+        SHA1_NI_ROUNDS( 7, e1, e0, m3, m0, m1, m2)
+        SHA1_NI_ROUNDS( 8, e0, e1, m0, m1, m2, m3)
+        SHA1_NI_ROUNDS( 9, e1, e0, m1, m2, m3, m0)
+        SHA1_NI_ROUNDS(10, e0, e1, m2, m3, m0, m1)
+        SHA1_NI_ROUNDS(11, e1, e0, m3, m0, m1, m2)
+        SHA1_NI_ROUNDS(12, e0, e1, m0, m1, m2, m3)
+        SHA1_NI_ROUNDS(13, e1, e0, m1, m2, m3, m0)
+        SHA1_NI_ROUNDS(14, e0, e1, m2, m3, m0, m1)
+        SHA1_NI_ROUNDS(15, e1, e0, m3, m0, m1, m2)
+        SHA1_NI_ROUNDS(16, e0, e1, m0, m1, m2, m3)
+        SHA1_NI_ROUNDS(17, e1, e0, m1, m2, m3, m0)
+        SHA1_NI_ROUNDS(18, e0, e1, m2, m3, m0, m1)
+        SHA1_NI_ROUNDS(19, e1, e0, m3, m0, m1, m2)
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+        data += 64;
+    }
+
+    _mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = _mm_extract_epi32(e0, 3);
+}
+
+#define SHA256_NI_ROUNDS(i, m0) \
+    tmp = _mm_add_epi32(m0, _mm_loadu_si128((const __m128i *) &sha256_k[4*(i)])); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, tmp); \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(tmp, 0x0e));
+
+#define SHA256_NI_SCHEDULE(m0, m1, m2, m3) \
+    m0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m0, m1), _mm_alignr_epi8(m3, m2, 4)), m3);
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_ni(uint32_t state[8], const unsigned char *data, size_t blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xb1); /* CDAB */
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1b); /* EFGH */
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); /* ABEF */
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0); /* CDGH */
+
+    while (blocks--) {
+        __m128i state0_save = state0;
+        __m128i state1_save = state1;
+        __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data)), mask);
+        __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data+16)), mask);
+        __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data+32)), mask);
+        __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data+48)), mask);
+
+        SHA256_NI_ROUNDS( 0, m0) SHA256_NI_SCHEDULE(m0, m1, m2, m3)
+        SHA256_NI_ROUNDS( 1, m1) SHA256_NI_SCHEDULE(m1, m2, m3, m0)
+        SHA256_NI_ROUNDS( 2, m2) SHA256_NI_SCHEDULE(m2, m3, m0, m1)
+        SHA256_NI_ROUNDS( 3, m3) SHA256_NI_SCHEDULE(m3, m0, m1, m2)
+        SHA256_NI_ROUNDS( 4, m0) SHA256_NI_SCHEDULE(m0, m1, m2, m3)
+        SHA256_NI_ROUNDS( 5, m1) SHA256_NI_SCHEDULE(m1, m2, m3, m0)
+        SHA256_NI_ROUNDS( 6, m2) SHA256_NI_SCHEDULE(m2, m3, m0, m1)
+        SHA256_NI_ROUNDS( 7, m3) SHA256_NI_SCHEDULE(m3, m0, m1, m2)
+        SHA256_NI_ROUNDS( 8, m0) SHA256_NI_SCHEDULE(m0, m1, m2, m3)
+        SHA256_NI_ROUNDS( 9, m1) SHA256_NI_SCHEDULE(m1, m2, m3, m0)
+        SHA256_NI_ROUNDS(10, m2) SHA256_NI_SCHEDULE(m2, m3, m0, m1)
+        SHA256_NI_ROUNDS(11, m3) SHA256_NI_SCHEDULE(m3, m0, m1, m2)
+        SHA256_NI_ROUNDS(12, m0)
+        SHA256_NI_ROUNDS(13, m1)
+        SHA256_NI_ROUNDS(14, m2)
+        SHA256_NI_ROUNDS(15, m3)
+
+        state0 = _mm_add_epi32(state0, state0_save);
+        state1 = _mm_add_epi32(state1, state1_save);
+        data += 64;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b); /* FEBA */
+    state1 = _mm_shuffle_epi32(state1, 0xb1); /* DCHG */
+    _mm_storeu_si128((__m128i *) &state[0], _mm_blend_epi16(tmp, state1, 0xf0)); /* DCBA */
+    _mm_storeu_si128((__m128i *) &state[4], _mm_alignr_epi8(state1, tmp, 8)); /* HGFE */
+}
+
+/* multi-buffer SHA-256 using AVX2 (8 messages in lock-step) */
+
+#define SHA256_MB_LANES 8
+
+#define ROTR256(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32-(n)))
+
+__attribute__((target("avx2")))
+static void sha256_mb_blocks_avx2(uint32_t state[8][SHA256_MB_LANES], const unsigned char *blocks[SHA256_MB_LANES]) {
+    __m256i w[16];
+    __m256i s[8];
+    for (int i = 0 ; i < 8 ; ++i) {
+        s[i] = _mm256_load_si256((const __m256i *) state[i]);
+    }
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int t = 0 ; t < 64 ; ++t) {
+        if (t < 16) {
+            w[t] = _mm256_setr_epi32(load_be32(blocks[0]+4*t), load_be32(blocks[1]+4*t),
+                    load_be32(blocks[2]+4*t), load_be32(blocks[3]+4*t), load_be32(blocks[4]+4*t),
+                    load_be32(blocks[5]+4*t), load_be32(blocks[6]+4*t), load_be32(blocks[7]+4*t));
+        } else {
+            __m256i w15 = w[(t-15)&15], w2 = w[(t-2)&15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR256(w15, 7), ROTR256(w15, 18)), _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR256(w2, 17), ROTR256(w2, 19)), _mm256_srli_epi32(w2, 10));
+            w[t&15] = _mm256_add_epi32(_mm256_add_epi32(w[t&15], s0), _mm256_add_epi32(w[(t-7)&15], s1));
+        }
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR256(e, 6), ROTR256(e, 11)), ROTR256(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, s1), _mm256_add_epi32(ch,
+                    _mm256_add_epi32(_mm256_set1_epi32(sha256_k[t]), w[t&15])));
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR256(a, 2), ROTR256(a, 13)), ROTR256(a, 22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+        d = c; c = b; b = a; a = _mm256_add_epi32(t1, _mm256_add_epi32(s0, maj));
+    }
+    s[0] = _mm256_add_epi32(s[0], a); s[1] = _mm256_add_epi32(s[1], b);
+    s[2] = _mm256_add_epi32(s[2], c); s[3] = _mm256_add_epi32(s[3], d);
+    s[4] = _mm256_add_epi32(s[4], e); s[5] = _mm256_add_epi32(s[5], f);
+    s[6] = _mm256_add_epi32(s[6], g); s[7] = _mm256_add_epi32(s[7], h);
+    for (int i = 0 ; i < 8 ; ++i) {
+        _mm256_store_si256((__m256i *) state[i], s[i]);
+    }
+}
+
+typedef struct sha256_mb_lane {
+    size_t message;
+    const unsigned char *data;
+    size_t full_blocks;
+    int tail_blocks;
+    unsigned char tail[128];
+} sha256_mb_lane;
+
+/*
+ * Every lane hashes one message, a lane is refilled with the next message
+ * as soon as its message has been processed
+ */
+static void sha256_multi_avx2(const unsigned char * const *data, const size_t *lengths, size_t n, unsigned char (*digests)[32]) {
+    static const unsigned char idle_block[64];
+    uint32_t state[8][SHA256_MB_LANES] __attribute__((aligned(32)));
+    sha256_mb_lane lanes[SHA256_MB_LANES];
+    const unsigned char *blocks[SHA256_MB_LANES];
+    bool active[SHA256_MB_LANES] = { false };
+    size_t next = 0;
+
+    while (1) {
+        int num_active = 0;
+        for (int l = 0 ; l < SHA256_MB_LANES ; ++l) {
+            if (!active[l] && next < n) {
+                sha256_mb_lane *lane = &lanes[l];
+                size_t rest = lengths[next] % 64;
+                lane->message = next;
+                lane->data = data[next];
+                lane->full_blocks = lengths[next] / 64;
+                lane->tail_blocks = rest + 9 > 64 ? 2 : 1;
+                memset(lane->tail, 0, sizeof(lane->tail));
+                memcpy(lane->tail, data[next] + lengths[next] - rest, rest);
+                lane->tail[rest] = 0x80;
+                store_be64(lane->tail + 64*lane->tail_blocks - 8, (uint64_t) lengths[next] << 3);
+                for (int i = 0 ; i < 8 ; ++i) {
+                    state[i][l] = sha256_h[i];
+                }
+                active[l] = true;
+                next++;
+            }
+            if (active[l]) {
+                num_active++;
+                blocks[l] = lanes[l].full_blocks ? lanes[l].data : lanes[l].tail;
+            } else {
+                blocks[l] = idle_block;
+            }
+        }
+        if (num_active == 0) {
+            break;
+        }
+
+        sha256_mb_blocks_avx2(state, blocks);
+
+        for (int l = 0 ; l < SHA256_MB_LANES ; ++l) {
+            if (active[l]) {
+                sha256_mb_lane *lane = &lanes[l];
+                if (lane->full_blocks) {
+                    lane->data += 64;
+                    lane->full_blocks--;
+                } else if (--lane->tail_blocks) {
+                    memmove(lane->tail, lane->tail + 64, 64);
+                } else {
+                    for (int i = 0 ; i < 8 ; ++i) {
+                        store_be32(digests[lane->message] + 4*i, state[i][l]);
+                    }
+                    active[l] = false;
+                }
+            }
+        }
+    }
+}
+
+/* CRC-32C using the SSE4.2 crc32 instruction (3 interleaved streams) */
+
+#define CRC32C_STREAM_LEN 2048
+
+/* extends a CRC-32C register by CRC32C_STREAM_LEN (0) and 2*CRC32C_STREAM_LEN (1) zero bytes */
+static uint32_t crc32c_shift_table[2][4][256];
+
+static inline uint32_t crc32c_shift(uint32_t table[4][256], uint32_t crc) {
+    return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^ table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_update_stream_sse42(uint32_t crc, const unsigned char *data, size_t length) {
+    uint64_t c = crc;
+    while (length >= 8) {
+        c = _mm_crc32_u64(c, load_le64(data));
+        data += 8;
+        length -= 8;
+    }
+    crc = c;
+    while (length--) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_update_sse42(uint32_t crc, const unsigned char *data, size_t length) {
+    /* the crc32 instruction has a latency of 3 cycles but a throughput of 1 */
+    while (length >= 3*CRC32C_STREAM_LEN) {
+        uint64_t c0 = crc, c1 = 0, c2 = 0;
+        for (size_t i = 0 ; i < CRC32C_STREAM_LEN ; i += 8) {
+            c0 = _mm_crc32_u64(c0, load_le64(data + i));
+            c1 = _mm_crc32_u64(c1, load_le64(data + CRC32C_STREAM_LEN + i));
+            c2 = _mm_crc32_u64(c2, load_le64(data + 2*CRC32C_STREAM_LEN + i));
+        }
+        /* the CRC register is linear: crc(a || b) = shift(crc(a), |b|) ^ crc(0, b) */
+        crc = crc32c_shift(crc32c_shift_table[1], c0) ^ crc32c_shift(crc32c_shift_table[0], c1) ^ (uint32_t) c2;
+        data += 3*CRC32C_STREAM_LEN;
+        length -= 3*CRC32C_STREAM_LEN;
+    }
+    return crc32c_update_stream_sse42(crc, data, length);
+}
+
+__attribute__((target("sse4.2")))
+static void init_crc32c_shift_table(void) {
+    static const unsigned char zeros[CRC32C_STREAM_LEN];
+    uint32_t basis[32];
+    for (int b = 0 ; b < 32 ; ++b) {
+        basis[b] = crc32c_update_stream_sse42(1U << b, zeros, CRC32C_STREAM_LEN);
+    }
+    for (int t = 0 ; t < 2 ; ++t) {
+        for (int k = 0 ; k < 4 ; ++k) {
+            for (uint32_t v = 0 ; v < 256 ; ++v) {
+                uint32_t crc = 0;
+                for (int j = 0 ; j < 8 ; ++j) {
+                    if (v & (1U << j)) {
+                        crc ^= basis[8*k+j];
+                    }
+                }
+                crc32c_shift_table[t][k][v] = crc;
+            }
+        }
+        for (int b = 0 ; b < 32 ; ++b) { /* shift twice for the second table */
+            basis[b] = crc32c_shift(crc32c_shift_table[0], basis[b]);
+        }
+    }
+}
+
+static bool cpu_has_sse42(void) {
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1 << 20)); /* SSE4.2 */
+}
+
+/* XXH3 using AVX2 (one stripe per 2 registers) */
+
+__attribute__((target("avx2")))
+static void xxh3_accumulate_avx2(uint64_t acc[8], const unsigned char *input, const unsigned char *secret, size_t stripes) {
+    __m256i a[2] = { _mm256_loadu_si256((const __m256i *) acc), _mm256_loadu_si256((const __m256i *) (acc+4)) };
+    for (size_t n = 0 ; n < stripes ; ++n) {
+        for (int i = 0 ; i < 2 ; ++i) {
+            __m256i data = _mm256_loadu_si256((const __m256i *) (input + n*XXH3_STRIPE_LEN + 32*i));
+            __m256i key = _mm256_loadu_si256((const __m256i *) (secret + n*8 + 32*i));
+            __m256i data_key = _mm256_xor_si256(data, key);
+            __m256i product = _mm256_mul_epu32(data_key, _mm256_srli_epi64(data_key, 32));
+            __m256i data_swap = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            a[i] = _mm256_add_epi64(a[i], _mm256_add_epi64(product, data_swap));
+        }
+    }
+    _mm256_storeu_si256((__m256i *) acc, a[0]);
+    _mm256_storeu_si256((__m256i *) (acc+4), a[1]);
+}
+
+__attribute__((target("avx2")))
+static void xxh3_scramble_avx2(uint64_t acc[8], const unsigned char *secret) {
+    const __m256i prime = _mm256_set1_epi32(XXH_PRIME32_1);
+    for (int i = 0 ; i < 2 ; ++i) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (acc + 4*i));
+        __m256i key = _mm256_loadu_si256((const __m256i *) (secret + 32*i));
+        a = _mm256_xor_si256(_mm256_xor_si256(a, _mm256_srli_epi64(a, 47)), key);
+        __m256i product_lo = _mm256_mul_epu32(a, prime);
+        __m256i product_hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+        _mm256_storeu_si256((__m256i *) (acc + 4*i), _mm256_add_epi64(product_lo, _mm256_slli_epi64(product_hi, 32)));
+    }
+}
+
+static bool cpu_has_avx2(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)
+            || !(ecx & (1 << 27)) /* OSXSAVE */ || !(ecx & (1 << 28)) /* AVX */) {
+        return false;
+    }
+    unsigned int xcr0_lo, xcr0_hi;
+    __asm__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+    if ((xcr0_lo & 0x6) != 0x6) { /* XMM and YMM state enabled by the OS */
+        return false;
+    }
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return ebx & (1 << 5); /* AVX2 */
+}
+
+static bool cpu_has_sha_ni(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)
+            || !(ecx & (1 << 9)) /* SSSE3 */ || !(ecx & (1 << 19)) /* SSE4.1 */) {
+        return false;
+    }
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return ebx & (1 << 29); /* SHA */
+}
+
+#endif /* NATIVE_HASH_X86 */
+
+static void (*sha1_blocks)(uint32_t *, const unsigned char *, size_t) = sha1_blocks_c;
+static void (*sha256_blocks)(uint32_t *, const unsigned char *, size_t) = sha256_blocks_c;
+static const char *sha_implementation = "portable";
+static void (*sha256_multi)(const unsigned char * const *, const size_t *, size_t, unsigned char (*)[32]) = NULL;
+static void (*blake3_hash8)(const unsigned char *, uint64_t, uint32_t [8][8]) = NULL;
+static uint32_t (*crc32c_update)(uint32_t, const unsigned char *, size_t) = crc32c_update_c;
+static void (*xxh3_accumulate)(uint64_t [8], const unsigned char *, const unsigned char *, size_t) = xxh3_accumulate_c;
+static void (*xxh3_scramble)(uint64_t [8], const unsigned char *) = xxh3_scramble_c;
+
+static pthread_once_t native_hash_once = PTHREAD_ONCE_INIT;
+
+static void select_native_hash_implementations(void) {
+    init_crc_table(crc32_table, 0xedb88320);
+    init_crc_table(crc32c_table, 0x82f63b78);
+#ifdef NATIVE_HASH_X86
+    if (cpu_has_sha_ni()) {
+        sha1_blocks = sha1_blocks_ni;
+        sha256_blocks = sha256_blocks_ni;
+        sha_implementation = "sha-ni";
+    } else if (cpu_has_avx2()) {
+        /* a single SHA-NI stream is faster than 8 AVX2 lanes */
+        sha256_multi = sha256_multi_avx2;
+    }
+    if (cpu_has_avx2()) {
+        blake3_hash8 = blake3_hash8_avx2;
+        xxh3_accumulate = xxh3_accumulate_avx2;
+        xxh3_scramble = xxh3_scramble_avx2;
+    }
+    if (cpu_has_sse42()) {
+        init_crc32c_shift_table();
+        crc32c_update = crc32c_update_sse42;
+    }
+#endif
+    log_msg(LOG_LEVEL_DEBUG, "native hashsums: use %s implementation for sha1 and sha256%s, %s implementation for blake3 and xxh3, %s implementation for crc32c",
+            sha_implementation, sha256_multi?" (multi-buffer sha256: avx2)":"", blake3_hash8?"avx2":"portable",
+            crc32c_update == crc32c_update_c?"slicing-by-8":"sse4.2");
+}
+
+/*
+ * BLAKE3 tree hashing
+ *
+ * Complete subtrees of the input are hashed independently (8 chunks at once
+ * with AVX2 and split across up to 'threads' threads), the chaining values of
+ * the subtrees are merged on a stack as described in the BLAKE3 paper.
+ */
+
+/* maximum number of chunks hashed at once without recursion */
+#define BLAKE3_LEAF_CHUNKS 64
+/* minimum number of chunks hashed by a separate thread */
+#define BLAKE3_THREAD_CHUNKS 256
+
+typedef struct blake3_state {
+    uint32_t cv[8];
+    uint64_t chunk_counter;
+    unsigned char block[BLAKE3_BLOCK_LEN];
+    size_t block_len;
+    size_t blocks_compressed;
+    uint32_t cv_stack[BLAKE3_MAX_DEPTH][8];
+    size_t cv_stack_len;
+    int threads;
+} blake3_state;
+
+/* chaining value of a complete subtree of 'chunks' (a power of 2) chunks */
+static void blake3_subtree_cv(const unsigned char *input, size_t chunks, uint64_t counter, uint32_t cv[8]) {
+    if (chunks > BLAKE3_LEAF_CHUNKS) {
+        uint32_t left[8], right[8];
+        blake3_subtree_cv(input, chunks/2, counter, left);
+        blake3_subtree_cv(input + (chunks/2)*BLAKE3_CHUNK_LEN, chunks/2, counter + chunks/2, right);
+        blake3_parent_cv(left, right, 0, cv);
+        return;
+    }
+    uint32_t cvs[BLAKE3_LEAF_CHUNKS][8];
+    size_t i = 0;
+    if (blake3_hash8) {
+        for ( ; i + 8 <= chunks ; i += 8) {
+            blake3_hash8(input + i*BLAKE3_CHUNK_LEN, counter + i, &cvs[i]);
+        }
+    }
+    for ( ; i < chunks ; ++i) {
+        blake3_chunk_cv_c(input + i*BLAKE3_CHUNK_LEN, counter + i, cvs[i]);
+    }
+    for (size_t n = chunks ; n > 1 ; n /= 2) {
+        for (i = 0 ; i < n/2 ; ++i) {
+            blake3_parent_cv(cvs[2*i], cvs[2*i+1], 0, cvs[i]);
+        }
+    }
+    memcpy(cv, cvs[0], 32);
+}
+
+typedef struct blake3_subtree_job {
+    pthread_t thread;
+    const unsigned char *input;
+    size_t chunks;
+    uint64_t counter;
+    uint32_t cv[8];
+} blake3_subtree_job;
+
+static void *blake3_subtree_thread(void *arg) {
+    blake3_subtree_job *job = arg;
+    blake3_subtree_cv(job->input, job->chunks, job->counter, job->cv);
+    return NULL;
+}
+
+/* same as blake3_subtree_cv() but splits the subtree across up to 'threads' threads */
+static void blake3_subtree_cv_threads(const unsigned char *input, size_t chunks, uint64_t counter, int threads, uint32_t cv[8]) {
+    size_t parts = 1;
+    while (parts*2 <= (size_t) threads && chunks/(parts*2) >= BLAKE3_THREAD_CHUNKS) {
+        parts *= 2;
+    }
+    if (parts == 1) {
+        blake3_subtree_cv(input, chunks, counter, cv);
+        return;
+    }
+    blake3_subtree_job jobs[parts];
+    size_t part_chunks = chunks/parts;
+    bool started[parts];
+    for (size_t i = 1 ; i < parts ; ++i) {
+        jobs[i].input = input + i*part_chunks*BLAKE3_CHUNK_LEN;
+        jobs[i].chunks = part_chunks;
+        jobs[i].counter = counter + i*part_chunks;
+        started[i] = pthread_create(&jobs[i].thread, NULL, &blake3_subtree_thread, &jobs[i]) == 0;
+    }
+    /* the first part is hashed by the calling thread */
+    blake3_subtree_cv(input, part_chunks, counter, jobs[0].cv);
+    for (size_t i = 1 ; i < parts ; ++i) {
+        if (started[i]) {
+            pthread_join(jobs[i].thread, NULL);
+        } else {
+            blake3_subtree_thread(&jobs[i]);
+        }
+    }
+    for (size_t n = parts ; n > 1 ; n /= 2) {
+        for (size_t i = 0 ; i < n/2 ; ++i) {
+            blake3_parent_cv(jobs[2*i].cv, jobs[2*i+1].cv, 0, jobs[i].cv);
+        }
+    }
+    memcpy(cv, jobs[0].cv, 32);
+}
+
+static size_t blake3_chunk_len(blake3_state *s) {
+    return s->blocks_compressed*BLAKE3_BLOCK_LEN + s->block_len;
+}
+
+static void blake3_chunk_reset(blake3_state *s, uint64_t counter) {
+    memcpy(s->cv, sha256_h, 32);
+    s->chunk_counter = counter;
+    s->block_len = 0;
+    s->blocks_compressed = 0;
+}
+
+static void blake3_chunk_update(blake3_state *s, const unsigned char *input, size_t length) {
+    while (length) {
+        if (s->block_len == BLAKE3_BLOCK_LEN) {
+            blake3_compress(s->cv, s->block, s->chunk_counter, BLAKE3_BLOCK_LEN, s->blocks_compressed == 0 ? BLAKE3_CHUNK_START : 0);
+            s->blocks_compressed++;
+            s->block_len = 0;
+        }
+        size_t n = BLAKE3_BLOCK_LEN - s->block_len;
+        if (n > length) {
+            n = length;
+        }
+        memcpy(s->block + s->block_len, input, n);
+        s->block_len += n;
+        input += n;
+        length -= n;
+    }
+}
+
+/* compresses the last block of the current chunk */
+static void blake3_chunk_output(blake3_state *s, uint32_t flags, uint32_t cv[8]) {
+    memset(s->block + s->block_len, 0, BLAKE3_BLOCK_LEN - s->block_len);
+    memcpy(cv, s->cv, 32);
+    blake3_compress(cv, s->block, s->chunk_counter, s->block_len,
+            (s->blocks_compressed == 0 ? BLAKE3_CHUNK_START : 0)|BLAKE3_CHUNK_END|flags);
+}
+
+/* merges the completed subtrees before chunk 'counter' (merges are delayed as the last one could be the root) */
+static void blake3_merge_cv_stack(blake3_state *s, uint64_t counter) {
+    size_t post_merge_stack_len = __builtin_popcountll(counter);
+    while (s->cv_stack_len > post_merge_stack_len) {
+        blake3_parent_cv(s->cv_stack[s->cv_stack_len-2], s->cv_stack[s->cv_stack_len-1], 0, s->cv_stack[s->cv_stack_len-2]);
+        s->cv_stack_len--;
+    }
+}
+
+/* pushes the chaining value of the subtree starting at chunk 'counter' */
+static void blake3_push_cv(blake3_state *s, const uint32_t cv[8], uint64_t counter) {
+    blake3_merge_cv_stack(s, counter);
+    memcpy(s->cv_stack[s->cv_stack_len++], cv, 32);
+}
+
+static void blake3_update(blake3_state *s, const unsigned char *input, size_t length) {
+    if (blake3_chunk_len(s) > 0) {
+        size_t n = BLAKE3_CHUNK_LEN - blake3_chunk_len(s);
+        if (n > length) {
+            n = length;
+        }
+        blake3_chunk_update(s, input, n);
+        input += n;
+        length -= n;
+        if (length == 0) {
+            return;
+        }
+        uint32_t cv[8];
+        blake3_chunk_output(s, 0, cv);
+        blake3_push_cv(s, cv, s->chunk_counter);
+        blake3_chunk_reset(s, s->chunk_counter + 1);
+    }
+    while (length > BLAKE3_CHUNK_LEN) {
+        /* largest complete subtree starting at the current chunk */
+        size_t subtree_len = (size_t) 1 << (63 - __builtin_clzll(length));
+        uint64_t count_so_far = s->chunk_counter*BLAKE3_CHUNK_LEN;
+        while (((subtree_len - 1) & count_so_far) != 0) {
+            subtree_len /= 2;
+        }
+        uint64_t subtree_chunks = subtree_len/BLAKE3_CHUNK_LEN;
+        uint32_t cv[8];
+        if (subtree_chunks <= 1) {
+            blake3_chunk_cv_c(input, s->chunk_counter, cv);
+            blake3_push_cv(s, cv, s->chunk_counter);
+        } else {
+            /* the subtree could be the whole (remaining) input, so keep its two children */
+            blake3_subtree_cv_threads(input, subtree_chunks/2, s->chunk_counter, s->threads, cv);
+            blake3_push_cv(s, cv, s->chunk_counter);
+            blake3_subtree_cv_threads(input + subtree_len/2, subtree_chunks/2, s->chunk_counter + subtree_chunks/2, s->threads, cv);
+            blake3_push_cv(s, cv, s->chunk_counter + subtree_chunks/2);
+        }
+        blake3_chunk_reset(s, s->chunk_counter + subtree_chunks);
+        input += subtree_len;
+        length -= subtree_len;
+    }
+    if (length > 0) {
+        blake3_chunk_update(s, input, length);
+        blake3_merge_cv_stack(s, s->chunk_counter);
+    }
+}
+
+static void blake3_final(blake3_state *s, unsigned char *hashsum) {
+    uint32_t cv[8];
+    if (s->cv_stack_len == 0) {
+        blake3_chunk_output(s, BLAKE3_ROOT, cv);
+    } else {
+        size_t remaining;
+        if (blake3_chunk_len(s) > 0) {
+            remaining = s->cv_stack_len;
+            blake3_chunk_output(s, 0, cv);
+        } else {
+            remaining = s->cv_stack_len - 1;
+            memcpy(cv, s->cv_stack[remaining], 32);
+        }
+        while (remaining > 0) {
+            remaining--;
+            blake3_parent_cv(s->cv_stack[remaining], cv, remaining == 0 ? BLAKE3_ROOT : 0, cv);
+        }
+    }
+    for (int i = 0 ; i < 8 ; ++i) {
+        hashsum[4*i] = cv[i]; hashsum[4*i+1] = cv[i] >> 8; hashsum[4*i+2] = cv[i] >> 16; hashsum[4*i+3] = cv[i] >> 24;
+    }
+}
+
+/* XXH3 streaming (inputs up to 240 bytes are hashed at once, see xxh3_short) */
+
+typedef struct xxh3_state {
+    uint64_t acc[8];
+    unsigned char buffer[XXH3_BUFFER_SIZE];
+    size_t buffer_length;
+    size_t stripes_so_far; /* of the current block */
+} xxh3_state;
+
+static void xxh3_consume_stripes(xxh3_state *s, const unsigned char *input, size_t stripes) {
+    while (stripes) {
+        size_t n = XXH3_STRIPES_PER_BLOCK - s->stripes_so_far;
+        if (n > stripes) {
+            n = stripes;
+        }
+        xxh3_accumulate(s->acc, input, xxh3_secret + s->stripes_so_far*8, n);
+        s->stripes_so_far += n;
+        input += n*XXH3_STRIPE_LEN;
+        stripes -= n;
+        if (s->stripes_so_far == XXH3_STRIPES_PER_BLOCK) {
+            xxh3_scramble(s->acc, xxh3_secret + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN);
+            s->stripes_so_far = 0;
+        }
+    }
+}
+
+/* the last stripe is always kept back as it is accumulated with a different secret */
+static void xxh3_update(xxh3_state *s, const unsigned char *input, size_t length) {
+    if (s->buffer_length + length <= XXH3_BUFFER_SIZE) {
+        memcpy(s->buffer + s->buffer_length, input, length);
+        s->buffer_length += length;
+        return;
+    }
+    if (s->buffer_length) {
+        size_t n = XXH3_BUFFER_SIZE - s->buffer_length;
+        memcpy(s->buffer + s->buffer_length, input, n);
+        xxh3_consume_stripes(s, s->buffer, XXH3_BUFFER_SIZE/XXH3_STRIPE_LEN);
+        s->buffer_length = 0;
+        input += n;
+        length -= n;
+    }
+    if (length > XXH3_STRIPE_LEN) {
+        size_t stripes = (length - 1)/XXH3_STRIPE_LEN;
+        xxh3_consume_stripes(s, input, stripes);
+        input += stripes*XXH3_STRIPE_LEN;
+        length -= stripes*XXH3_STRIPE_LEN;
+        memcpy(s->buffer + XXH3_BUFFER_SIZE - XXH3_STRIPE_LEN, input - XXH3_STRIPE_LEN, XXH3_STRIPE_LEN);
+    }
+    memcpy(s->buffer, input, length);
+    s->buffer_length = length;
+}
+
+static uint64_t xxh3_final(xxh3_state *s, uint64_t total_length) {
+    if (total_length <= 240) {
+        return xxh3_short(s->buffer, total_length);
+    }
+    unsigned char last_stripe[XXH3_STRIPE_LEN];
+    const unsigned char *last;
+    if (s->buffer_length >= XXH3_STRIPE_LEN) {
+        xxh3_consume_stripes(s, s->buffer, (s->buffer_length - 1)/XXH3_STRIPE_LEN);
+        last = s->buffer + s->buffer_length - XXH3_STRIPE_LEN;
+    } else {
+        /* the end of the buffer still holds the previous input */
+        size_t catchup = XXH3_STRIPE_LEN - s->buffer_length;
+        memcpy(last_stripe, s->buffer + XXH3_BUFFER_SIZE - catchup, catchup);
+        memcpy(last_stripe + catchup, s->buffer, s->buffer_length);
+        last = last_stripe;
+    }
+    xxh3_accumulate(s->acc, last, xxh3_secret + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN - 7, 1);
+
+    uint64_t result = total_length * XXH_PRIME64_1;
+    for (int i = 0 ; i < 4 ; ++i) {
+        result += xxh3_mul128_fold64(s->acc[2*i] ^ load_le64(xxh3_secret + 11 + 16*i), s->acc[2*i+1] ^ load_le64(xxh3_secret + 11 + 16*i + 8));
+    }
+    return xxh3_avalanche(result);
+}
+
+bool native_hash_available(HASHSUM hashsum) {
+    switch (hashsum) {
+        case hash_sha1:
+        case hash_sha256:
+        case hash_sha512:
+            return true;
+#ifdef WITH_GCRYPT
+        case hash_crc32: /* mhash's CRC32 is not ISO 3309 */
+            return true;
+#endif
+        case hash_blake3:
+        case hash_xxh3:
+        case hash_crc32c:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const char *native_hash_implementation(HASHSUM hashsum) {
+    pthread_once(&native_hash_once, select_native_hash_implementations);
+    switch (hashsum) {
+        case hash_sha1:
+        case hash_sha256:
+            return sha_implementation;
+        case hash_sha512:
+            return "portable";
+        case hash_crc32:
+            return "slicing-by-8";
+        case hash_blake3:
+            return blake3_hash8?"avx2":"portable";
+        case hash_xxh3:
+            return xxh3_accumulate == xxh3_accumulate_c?"portable":"avx2";
+        case hash_crc32c:
+            return crc32c_update == crc32c_update_c?"slicing-by-8":"sse4.2";
+        default:
+            return NULL;
+    }
+}
+
+bool native_hash_faster(HASHSUM hashsum) {
+    pthread_once(&native_hash_once, select_native_hash_implementations);
+    switch (hashsum) {
+#ifdef WITH_GCRYPT
+        /* libgcrypt uses SSSE3/AVX2 (sha1, sha256, sha512) and PCLMUL (crc32) */
+        case hash_sha1:
+        case hash_sha256:
+            return sha1_blocks != sha1_blocks_c;
+        case hash_sha512:
+        case hash_crc32:
+            return false;
+#endif
+        default:
+            return native_hash_available(hashsum);
+    }
+}
+
+bool native_hash_sha256_multi_buffer(void) {
+    pthread_once(&native_hash_once, select_native_hash_implementations);
+    return sha256_multi != NULL;
+}
+
+bool native_hash_force_sha256_multi_buffer(void) {
+    pthread_once(&native_hash_once, select_native_hash_implementations);
+#ifdef NATIVE_HASH_X86
+    if (cpu_has_avx2()) {
+        sha256_multi = sha256_multi_avx2;
+    }
+#endif
+    return sha256_multi != NULL;
+}
+
+void native_hash_sha256_multi(const unsigned char * const *data, const size_t *lengths, size_t n, unsigned char (*digests)[32]) {
+    pthread_once(&native_hash_once, select_native_hash_implementations);
+    if (sha256_multi) {
+        sha256_multi(data, lengths, n, digests);
+    } else {
+        for (size_t i = 0 ; i < n ; ++i) {
+            native_hash_ctx ctx;
+            native_hash_init(&ctx, hash_sha256);
+            native_hash_update(&ctx, data[i], lengths[i]);
+            native_hash_final(&ctx, digests[i]);
+        }
+    }
+}
+
+void native_hash_init(native_hash_ctx *ctx, HASHSUM hashsum) {
+    pthread_once(&native_hash_once, select_native_hash_implementations);
+    ctx->hashsum = hashsum;
+    ctx->length = 0;
+    ctx->buffer_length = 0;
+    switch (hashsum) {
+        case hash_sha1:
+            memcpy(ctx->state.sha1, sha1_h, sizeof(sha1_h));
+            break;
+        case hash_sha256:
+            memcpy(ctx->state.sha256, sha256_h, sizeof(sha256_h));
+            break;
+        case hash_sha512:
+            memcpy(ctx->state.sha512, sha512_h, sizeof(sha512_h));
+            break;
+        case hash_blake3:
+            ctx->state.blake3 = checked_malloc(sizeof(blake3_state));
+            blake3_chunk_reset(ctx->state.blake3, 0);
+            ctx->state.blake3->cv_stack_len = 0;
+            ctx->state.blake3->threads = 1;
+            break;
+        case hash_xxh3: {
+            static const uint64_t acc[8] = { XXH_PRIME32_3, XXH_PRIME64_1, XXH_PRIME64_2, XXH_PRIME64_3,
+                XXH_PRIME64_4, XXH_PRIME32_2, XXH_PRIME64_5, XXH_PRIME32_1 };
+            ctx->state.xxh3 = checked_malloc(sizeof(xxh3_state));
+            memcpy(ctx->state.xxh3->acc, acc, sizeof(acc));
+            ctx->state.xxh3->buffer_length = 0;
+            ctx->state.xxh3->stripes_so_far = 0;
+            break;
+        }
+        default:
+            ctx->state.crc32 = 0xffffffff;
+            break;
+    }
+}
+
+void native_hash_set_threads(native_hash_ctx *ctx, int threads) {
+    if (ctx->hashsum == hash_blake3) {
+        ctx->state.blake3->threads = threads > 1 ? threads : 1;
+    }
+}
+
+static void native_hash_blocks(native_hash_ctx *ctx, const unsigned char *data, size_t blocks) {
+    switch (ctx->hashsum) {
+        case hash_sha1:
+            sha1_blocks(ctx->state.sha1, data, blocks);
+            break;
+        case hash_sha256:
+            sha256_blocks(ctx->state.sha256, data, blocks);
+            break;
+        default:
+            sha512_blocks_c(ctx->state.sha512, data, blocks);
+            break;
+    }
+}
+
+void native_hash_update(native_hash_ctx *ctx, const void *data, size_t length) {
+    const unsigned char *p = data;
+    ctx->length += length;
+    if (ctx->hashsum == hash_crc32) {
+        ctx->state.crc32 = crc_update(crc32_table, ctx->state.crc32, p, length);
+        return;
+    }
+    if (ctx->hashsum == hash_crc32c) {
+        ctx->state.crc32 = crc32c_update(ctx->state.crc32, p, length);
+        return;
+    }
+    if (ctx->hashsum == hash_xxh3) {
+        xxh3_update(ctx->state.xxh3, p, length);
+        return;
+    }
+    if (ctx->hashsum == hash_blake3) {
+        blake3_update(ctx->state.blake3, p, length);
+        return;
+    }
+    size_t block_size = ctx->hashsum == hash_sha512 ? 128 : 64;
+    if (ctx->buffer_length) {
+        size_t n = block_size - ctx->buffer_length;
+        if (n > length) {
+            n = length;
+        }
+        memcpy(ctx->buffer + ctx->buffer_length, p, n);
+        ctx->buffer_length += n;
+        p += n;
+        length -= n;
+        if (ctx->buffer_length < block_size) {
+            return;
+        }
+        native_hash_blocks(ctx, ctx->buffer, 1);
+        ctx->buffer_length = 0;
+    }
+    if (length >= block_size) {
+        native_hash_blocks(ctx, p, length / block_size);
+        p += length - length % block_size;
+        length %= block_size;
+    }
+    if (length) {
+        memcpy(ctx->buffer, p, length);
+        ctx->buffer_length = length;
+    }
+}
+
+void native_hash_final(native_hash_ctx *ctx, unsigned char *hashsum) {
+    if (ctx->hashsum == hash_crc32 || ctx->hashsum == hash_crc32c) {
+        store_be32(hashsum, ~ctx->state.crc32);
+        return;
+    }
+    if (ctx->hashsum == hash_xxh3) {
+        store_be64(hashsum, xxh3_final(ctx->state.xxh3, ctx->length));
+        free(ctx->state.xxh3);
+        ctx->state.xxh3 = NULL;
+        return;
+    }
+    if (ctx->hashsum == hash_blake3) {
+        blake3_final(ctx->state.blake3, hashsum);
+        free(ctx->state.blake3);
+        ctx->state.blake3 = NULL;
+        return;
+    }
+    size_t block_size = ctx->hashsum == hash_sha512 ? 128 : 64;
+    size_t length_size = ctx->hashsum == hash_sha512 ? 16 : 8;
+    uint64_t length = ctx->length;
+
+    ctx->buffer[ctx->buffer_length++] = 0x80;
+    if (ctx->buffer_length > block_size - length_size) {
+        memset(ctx->buffer + ctx->buffer_length, 0, block_size - ctx->buffer_length);
+        native_hash_blocks(ctx, ctx->buffer, 1);
+        ctx->buffer_length = 0;
+    }
+    memset(ctx->buffer + ctx->buffer_length, 0, block_size - ctx->buffer_length);
+    if (length_size == 16) {
+        store_be64(ctx->buffer + block_size - 16, length >> 61);
+    }
+    store_be64(ctx->buffer + block_size - 8, length << 3);
+    native_hash_blocks(ctx, ctx->buffer, 1);
+
+    switch (ctx->hashsum) {
+        case hash_sha1:
+            for (int i = 0 ; i < 5 ; ++i) {
+                store_be32(hashsum + 4*i, ctx->state.sha1[i]);
+            }
+            break;
+        case hash_sha256:
+            for (int i = 0 ; i < 8 ; ++i) {
+                store_be32(hashsum + 4*i, ctx->state.sha256[i]);
+            }
+            break;
+        default:
+            for (int i = 0 ; i < 8 ; ++i) {
+                store_be64(hashsum + 8*i, ctx->state.sha512[i]);
+            }
+            break;
+    }
+}
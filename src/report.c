@@ -101,6 +101,9 @@ const ATTRIBUTE report_attrs_order[] = {
 #ifdef WITH_CAPABILITIES
    attr_capabilities,
 #endif
+#ifdef HAVE_STATX
+   attr_btime,
+#endif
 };
 
 int report_attrs_order_length = sizeof(report_attrs_order)/sizeof(ATTRIBUTE);
@@ -463,6 +466,7 @@ bool add_report_url(url_t* url, int linenumber, char* filename, char* linebuf) {
     r->nadd = 0;
     r->nrem = 0;
     r->nchg = 0;
+    r->ncarried = 0;
 
     r->diff_attrs_entries = NULL;
     r->num_diff_attrs_entries = 0;
@@ -594,6 +598,7 @@ snprintf(*values[0], l, "%s",s);
         easy_time(ATTR(attr_atime),atime)
         easy_time(ATTR(attr_mtime),mtime)
         easy_time(ATTR(attr_ctime),ctime)
+        easy_time(ATTR(attr_btime),btime)
         easy_number(ATTR(attr_bcount),bcount,"%lli")
         easy_number(ATTR(attr_uid),uid,"%li")
         easy_number(ATTR(attr_gid),gid,"%li")
@@ -714,6 +719,7 @@ static void terse_report(seltree* node) {
 
     if ((node->checked&(DB_OLD|DB_NEW)) != 0) {
         r->ntotal += ((node->checked&DB_NEW) != 0);
+        r->ncarried += ((node->checked&NODE_HASHSUMS_CARRIED_OVER) != 0);
         if (!(node->checked&DB_OLD)){
             /* File is in new db but not old. (ADDED) */
             /* unless it was moved in */
@@ -803,6 +809,17 @@ void print_report_entries(report_t *report, seltree* node, const int node_status
     pthread_mutex_unlock(&node->mutex);
 }
 
+void print_carried_over_entries(report_t *report, seltree* node, void (*print_line)(report_t*, char*)) {
+    pthread_mutex_lock(&node->mutex);
+    if (node->checked&NODE_HASHSUMS_CARRIED_OVER && node->new_data) {
+        print_line(report, node->new_data->filename);
+    }
+    for(tree_node *x = tree_walk_first(node->children); x != NULL ; x = tree_walk_next(x)) {
+        print_carried_over_entries(report, tree_get_data(x), print_line);
+    }
+    pthread_mutex_unlock(&node->mutex);
+}
+
 void print_dbline_attrs(report_t * report, db_line* oline, db_line* nline, DB_ATTR_TYPE report_attrs, void (*print_attribute)(report_t *, db_line*, db_line*, ATTRIBUTE)) {
     for (int j=0; j < report_attrs_order_length; ++j) {
         switch(report_attrs_order[j]) {
@@ -927,6 +944,9 @@ static void print_report(report_t * report, seltree * node, report_format_module
                     module.print_report_entries(report, node, NODE_ADDED|NODE_REMOVED|NODE_CHANGED);
                 }
             }
+            if (report->ncarried) {
+                module.print_report_carried_over_entries(report, node);
+            }
         }
         if ( (report->nchg && report->level >= REPORT_LEVEL_CHANGED_ATTRIBUTES) || ( (report->nadd || report->nrem) && report->level >= REPORT_LEVEL_ADDED_REMOVED_ENTRIES) ) {
             module.print_report_details(report, node);
@@ -249,7 +249,13 @@ static void print_report_summary_json(report_t *report) {
         report_printf(report, JSON_FMT_LONG, 4, ' ', "total", report->ntotal);
         report_printf(report, JSON_FMT_LONG, 4, ' ', "added", report->nadd);
         report_printf(report, JSON_FMT_LONG, 4, ' ', "removed", report->nrem);
+        if (report->ncarried) {
+            report_printf(report, JSON_FMT_LONG, 4, ' ', "carried_over_hashsums", report->ncarried);
+        }
         report_printf(report, JSON_FMT_LONG_LAST, 4, ' ', "changed", report->nchg);
+    } else if (report->ncarried) {
+        report_printf(report, JSON_FMT_LONG, 4, ' ', "total", report->ntotal);
+        report_printf(report, JSON_FMT_LONG_LAST, 4, ' ', "carried_over_hashsums", report->ncarried);
     } else {
         report_printf(report, JSON_FMT_LONG_LAST, 4, ' ', "total", report->ntotal);
     }
@@ -297,6 +303,23 @@ static void print_report_entries_json(report_t *report, seltree* node, const int
     report_printf(report, report->summarize_changes||!report->grouped?JSON_FMT_OBJECT_END:JSON_FMT_ARRAY_END, 2, ' ');
 }
 
+static void print_line_carried_over_json(report_t* report, char* filename) {
+    if (line_first) { line_first=false; }
+    else { report_printf(report,",\n"); }
+
+    char *escaped_filename = _get_escaped_json_string(filename);
+    report_printf(report, JSON_FMT_ARRAY_ELEMENT_PLAIN, 4, ' ', escaped_filename);
+    free(escaped_filename);
+}
+
+static void print_report_carried_over_entries_json(report_t *report, seltree* node) {
+    line_first = true;
+    report_printf(report, JSON_FMT_ARRAY_BEGIN, 2, ' ', "carried_over_hashsums");
+    print_carried_over_entries(report, node, print_line_carried_over_json);
+    report_printf(report,"\n");
+    report_printf(report, JSON_FMT_ARRAY_END, 2, ' ');
+}
+
 static void print_report_diff_attrs_entries_json(report_t *report) {
     if (report->num_diff_attrs_entries) {
         report_printf(report, JSON_FMT_OBJECT_BEGIN, 2, ' ', "different_attributes");
@@ -315,6 +338,7 @@ static void print_report_diff_attrs_entries_json(report_t *report) {
 }
 
 report_format_module report_module_json = {
+    .print_report_carried_over_entries = print_report_carried_over_entries_json,
     .print_report_config_options = print_report_config_options_json,
     .print_report_databases = print_report_databases_json,
     .print_report_details = print_report_details_json,
@@ -131,6 +131,9 @@ static void print_report_summary_plain(report_t *report) {
     } else {
         report_printf(report, _("\nNumber of entries:\t%li"), report->ntotal);
     }
+    if (report->ncarried) {
+        report_printf(report, _("\nEntries with carried over hashsums (trustctime):\t%li"), report->ncarried);
+    }
 }
 
 static void print_line_plain(report_t* report, char* filename, int node_checked, seltree* node) {
@@ -190,6 +193,15 @@ static void print_report_details_plain(report_t *report, seltree* node) {
     print_report_details(report, node, print_report_dbline_attributes_plain);
 }
 
+static void print_line_carried_over_plain(report_t* report, char* filename) {
+    report_printf(report, _("\ncarried over: %s"), filename);
+}
+
+static void print_report_carried_over_entries_plain(report_t *report, seltree* node) {
+    report_printf(report, PLAIN_REPORT_HEADLINE_FMT,_("Entries with carried over hashsums (trustctime)"));
+    print_carried_over_entries(report, node, print_line_carried_over_plain);
+}
+
 static void print_report_diff_attrs_entries_plain(report_t *report) {
     for(int i = 0; i < report->num_diff_attrs_entries; ++i) {
         char *str = NULL;
@@ -203,6 +215,7 @@ static void print_report_diff_attrs_entries_plain(report_t *report) {
 }
 
 report_format_module report_module_plain = {
+    .print_report_carried_over_entries = print_report_carried_over_entries_plain,
     .print_report_config_options = print_report_config_options_plain,
     .print_report_databases = print_report_databases_plain,
     .print_report_details = print_report_details_plain,
@@ -0,0 +1,257 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include <pthread.h>
+
+#include "ring.h"
+#include "log.h"
+#include "util.h"
+
+/*
+ * Bounded multi-producer multi-consumer queue as described by Dmitry Vyukov:
+ * every cell carries a sequence number which tells producers and consumers
+ * whether the cell is free for the current lap, so the fast path only needs
+ * a single compare-and-swap on the enqueue or dequeue position.
+ *
+ * Threads which have to wait (producers on a full queue, consumers on an
+ * empty queue) fall back to a mutex and condition variable. The counterpart
+ * only touches the mutex if a thread is actually waiting.
+ */
+
+#define RING_CACHE_LINE_SIZE 64
+
+typedef struct ring_cell_s {
+    atomic_size_t sequence;
+    void *data;
+} ring_cell_t;
+
+struct ring_s {
+    /* keep producer and consumer positions on separate cache lines */
+    _Alignas(RING_CACHE_LINE_SIZE) atomic_size_t enqueue_pos;
+    _Alignas(RING_CACHE_LINE_SIZE) atomic_size_t dequeue_pos;
+
+    _Alignas(RING_CACHE_LINE_SIZE) ring_cell_t *cells;
+    size_t mask;
+
+    atomic_int waiting_producers;
+    atomic_int waiting_consumers;
+    atomic_bool release;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+};
+
+LOG_LEVEL ring_log_level = LOG_LEVEL_TRACE;
+
+ring_ts_t *ring_ts_init(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    ring_ts_t *ring = checked_aligned_alloc(RING_CACHE_LINE_SIZE, sizeof(ring_ts_t)); /* freed in ring_ts_free */
+    ring->cells = checked_aligned_alloc(RING_CACHE_LINE_SIZE, size*sizeof(ring_cell_t)); /* freed in ring_ts_free */
+    for (size_t i = 0 ; i < size ; ++i) {
+        atomic_init(&ring->cells[i].sequence, i);
+        ring->cells[i].data = NULL;
+    }
+    ring->mask = size - 1;
+
+    atomic_init(&ring->enqueue_pos, 0);
+    atomic_init(&ring->dequeue_pos, 0);
+    atomic_init(&ring->waiting_producers, 0);
+    atomic_init(&ring->waiting_consumers, 0);
+    atomic_init(&ring->release, false);
+
+    pthread_mutex_init(&ring->mutex, NULL);
+    pthread_cond_init(&ring->not_full, NULL);
+    pthread_cond_init(&ring->not_empty, NULL);
+
+    log_msg(ring_log_level, "ring(%p): create new ring queue (capacity: %zu)", (void*) ring, size);
+    return ring;
+}
+
+void ring_ts_free(ring_ts_t *ring) {
+    if (ring) {
+        pthread_cond_destroy(&ring->not_empty);
+        pthread_cond_destroy(&ring->not_full);
+        pthread_mutex_destroy(&ring->mutex);
+        free(ring->cells);
+        free(ring);
+    }
+}
+
+size_t ring_ts_capacity(ring_ts_t * const ring) {
+    return ring->mask + 1;
+}
+
+/* approximate number of queued elements */
+size_t ring_ts_size(ring_ts_t * const ring) {
+    size_t dequeue_pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+    size_t enqueue_pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+}
+
+static bool ring_push(ring_ts_t * const ring, void * const data) {
+    ring_cell_t *cell;
+    size_t pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    while (1) {
+        cell = &ring->cells[pos & ring->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; /* full */
+        } else {
+            pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    cell->data = data;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+static void *ring_pop(ring_ts_t * const ring) {
+    ring_cell_t *cell;
+    size_t pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+    while (1) {
+        cell = &ring->cells[pos & ring->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->dequeue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return NULL; /* empty */
+        } else {
+            pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    void *data = cell->data;
+    atomic_store_explicit(&cell->sequence, pos + ring->mask + 1, memory_order_release);
+    return data;
+}
+
+/* must not be called with the mutex locked */
+static void ring_wake(ring_ts_t * const ring, atomic_int *waiting, pthread_cond_t *cond, bool broadcast) {
+    /* pairs with the fence in ring_wait_prepare */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiting, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&ring->mutex);
+        if (broadcast) {
+            pthread_cond_broadcast(cond);
+        } else {
+            pthread_cond_signal(cond);
+        }
+        pthread_mutex_unlock(&ring->mutex);
+    }
+}
+
+/* mutex has to be locked */
+static void ring_wait_prepare(atomic_int *waiting) {
+    atomic_fetch_add_explicit(waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+bool ring_ts_try_enqueue(ring_ts_t * const ring, void * const data) {
+    if (ring_push(ring, data)) {
+        ring_wake(ring, &ring->waiting_consumers, &ring->not_empty, false);
+        return true;
+    }
+    return false;
+}
+
+void ring_ts_enqueue(ring_ts_t * const ring, void * const data, const char *whoami) {
+    if (!ring_push(ring, data)) {
+        pthread_mutex_lock(&ring->mutex);
+        ring_wait_prepare(&ring->waiting_producers);
+        while (!ring_push(ring, data)) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: ring(%p): queue is full, wait for free cell", whoami, (void*) ring);
+            pthread_cond_wait(&ring->not_full, &ring->mutex);
+        }
+        atomic_fetch_sub_explicit(&ring->waiting_producers, 1, memory_order_relaxed);
+        pthread_mutex_unlock(&ring->mutex);
+    }
+    ring_wake(ring, &ring->waiting_consumers, &ring->not_empty, false);
+}
+
+void *ring_ts_dequeue(ring_ts_t * const ring, const char *whoami) {
+    void *data = ring_pop(ring);
+    if (data) {
+        ring_wake(ring, &ring->waiting_producers, &ring->not_full, false);
+    }
+    log_msg(LOG_LEVEL_THREAD, "%10s: ring(%p): dequeue without waiting returned %p", whoami, (void*) ring, data);
+    return data;
+}
+
+void *ring_ts_dequeue_wait(ring_ts_t * const ring, const char *whoami) {
+    void *data = ring_pop(ring);
+    if (data == NULL) {
+        pthread_mutex_lock(&ring->mutex);
+        ring_wait_prepare(&ring->waiting_consumers);
+        while ((data = ring_pop(ring)) == NULL && !atomic_load(&ring->release)) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: ring(%p): waiting for new element", whoami, (void*) ring);
+            pthread_cond_wait(&ring->not_empty, &ring->mutex);
+        }
+        atomic_fetch_sub_explicit(&ring->waiting_consumers, 1, memory_order_relaxed);
+        pthread_mutex_unlock(&ring->mutex);
+    }
+    if (data) {
+        ring_wake(ring, &ring->waiting_producers, &ring->not_full, false);
+    } else {
+        log_msg(ring_log_level, "ring(%p): return NULL from empty, released queue", (void*) ring);
+    }
+    return data;
+}
+
+size_t ring_ts_dequeue_batch_wait(ring_ts_t * const ring, void **data, size_t n, const char *whoami) {
+    if (n == 0 || (data[0] = ring_ts_dequeue_wait(ring, whoami)) == NULL) {
+        return 0;
+    }
+    size_t i = 1;
+    while (i < n && (data[i] = ring_pop(ring)) != NULL) {
+        ++i;
+    }
+    if (i > 1) {
+        ring_wake(ring, &ring->waiting_producers, &ring->not_full, true);
+    }
+    log_msg(LOG_LEVEL_THREAD, "%10s: ring(%p): dequeued batch of %zu elements", whoami, (void*) ring, i);
+    return i;
+}
+
+/* must only be called after the last element has been enqueued */
+void ring_ts_release(ring_ts_t * const ring, const char *whoami) {
+    atomic_store(&ring->release, true);
+    pthread_mutex_lock(&ring->mutex);
+    pthread_cond_broadcast(&ring->not_empty);
+    pthread_mutex_unlock(&ring->mutex);
+    log_msg(LOG_LEVEL_THREAD, "%10s: ring(%p): release queue and broadcast waiting threads", whoami, (void*) ring);
+}
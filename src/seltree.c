@@ -146,10 +146,14 @@ static seltree *create_seltree_node(char *path, seltree *parent) {
     return node;
 }
 
+/* returns the existing node if it has been inserted concurrently by another thread */
 static seltree *_insert_new_node(char *path, seltree *parent) {
-    seltree *node = create_seltree_node(path, parent);
     pthread_mutex_lock(&parent->mutex);
-    parent ->children = tree_insert(parent->children, strrchr(node->path,'/'), (void*)node, (tree_cmp_f) strcmp);
+    seltree *node = tree_search(parent->children, strrchr(path,'/'), (tree_cmp_f) strcmp);
+    if (node == NULL) {
+        node = create_seltree_node(path, parent);
+        parent ->children = tree_insert(parent->children, strrchr(node->path,'/'), (void*)node, (tree_cmp_f) strcmp);
+    }
     pthread_mutex_unlock(&parent->mutex);
     return node;
 }
@@ -222,6 +226,23 @@ bool is_tree_empty(seltree *node) {
     return is_empty;
 }
 
+/* returns the union of the attributes of all selective and equal rules */
+DB_ATTR_TYPE get_tree_attributes(seltree *node) {
+    DB_ATTR_TYPE attr = 0LLU;
+    pthread_mutex_lock(&node->mutex);
+    for(list *r=node->equ_rx_lst;r!=NULL;r=r->next) {
+        attr |= ((rx_rule*)r->data)->attr;
+    }
+    for(list *r=node->sel_rx_lst;r!=NULL;r=r->next) {
+        attr |= ((rx_rule*)r->data)->attr;
+    }
+    for(tree_node *n = tree_walk_first(node->children); n != NULL ; n = tree_walk_next(n)) {
+        attr |= get_tree_attributes(tree_get_data(n));
+    }
+    pthread_mutex_unlock(&node->mutex);
+    return attr;
+}
+
 rx_rule * add_rx_to_tree(char * rx, RESTRICTION_TYPE restriction, AIDE_RULE_TYPE rule_type, seltree *tree, int linenumber, char* filename, char* linebuf, char **node_path) {
     rx_rule* r = NULL;
     seltree *curnode = NULL;
@@ -0,0 +1,267 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <liburing.h>
+
+#include "aide.h"
+#include "uring.h"
+#include "do_md.h"
+#include "md.h"
+#include "log.h"
+#include "util.h"
+#include "errorcodes.h"
+#include "hashsum.h"
+
+#ifndef HAVE_STATX
+#error "io_uring support requires statx()"
+#endif
+
+#define URING_QUEUE_DEPTH (2*URING_MAX_FILES)
+#define URING_READ_BLOCK_SIZE 1048576
+
+struct uring_engine {
+    struct io_uring ring;
+    char *bufs[URING_MAX_FILES];
+    const char *whoami;
+};
+
+typedef enum uring_state {
+    URING_OPEN,
+    URING_STAT,
+    URING_READ,
+    URING_CLOSE,
+} uring_state;
+
+typedef struct uring_file {
+    uring_hash_request *req;
+    uring_state state;
+    int open_flags;
+    int fd;
+    off_t offset;
+    char *buf;
+    struct statx stx;
+    struct md_container mdc;
+    bool md_initialized;
+} uring_file;
+
+uring_engine *uring_engine_init(const char *whoami) {
+    uring_engine *engine = checked_malloc(sizeof(uring_engine)); /* freed in uring_engine_free */
+    int ret = io_uring_queue_init(URING_QUEUE_DEPTH, &engine->ring, 0);
+    if (ret < 0) {
+        log_msg(LOG_LEVEL_WARNING, "%10s: io_uring_queue_init() failed: %s (fall back to synchronous I/O)", whoami, strerror(-ret));
+        free(engine);
+        return NULL;
+    }
+    struct io_uring_probe *probe = io_uring_get_probe_ring(&engine->ring);
+    if (probe == NULL
+            || !io_uring_opcode_supported(probe, IORING_OP_OPENAT)
+            || !io_uring_opcode_supported(probe, IORING_OP_STATX)
+            || !io_uring_opcode_supported(probe, IORING_OP_READ)
+            || !io_uring_opcode_supported(probe, IORING_OP_CLOSE)) {
+        log_msg(LOG_LEVEL_WARNING, "%10s: io_uring does not support the needed operations (fall back to synchronous I/O)", whoami);
+        if (probe) {
+            io_uring_free_probe(probe);
+        }
+        io_uring_queue_exit(&engine->ring);
+        free(engine);
+        return NULL;
+    }
+    io_uring_free_probe(probe);
+    for (int i = 0 ; i < URING_MAX_FILES ; ++i) {
+        engine->bufs[i] = checked_malloc(URING_READ_BLOCK_SIZE); /* freed in uring_engine_free */
+    }
+    engine->whoami = whoami;
+    log_msg(LOG_LEVEL_THREAD, "%10s: initialized io_uring engine (queue depth: %d)", whoami, URING_QUEUE_DEPTH);
+    return engine;
+}
+
+void uring_engine_free(uring_engine *engine) {
+    if (engine) {
+        io_uring_queue_exit(&engine->ring);
+        for (int i = 0 ; i < URING_MAX_FILES ; ++i) {
+            free(engine->bufs[i]);
+        }
+        free(engine);
+    }
+}
+
+static void uring_prep(uring_engine *engine, uring_file *file) {
+    /* every file has at most one pending request, so the queue never is full */
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&engine->ring);
+    switch (file->state) {
+        case URING_OPEN:
+            io_uring_prep_openat(sqe, AT_FDCWD, file->req->fullpath, file->open_flags, 0);
+            break;
+        case URING_STAT:
+            io_uring_prep_statx(sqe, file->fd, "", AT_EMPTY_PATH|AT_STATX_SYNC_AS_STAT, conf->statx_mask, &file->stx);
+            break;
+        case URING_READ:
+            io_uring_prep_read(sqe, file->fd, file->buf, URING_READ_BLOCK_SIZE, file->offset);
+            break;
+        case URING_CLOSE:
+            io_uring_prep_close(sqe, file->fd);
+            break;
+    }
+    io_uring_sqe_set_data(sqe, file);
+}
+
+/* the file is handed over to calc_hashsums() which also logs the error */
+static void uring_fail(uring_engine *engine, uring_file *file, const char *reason) {
+    log_msg(LOG_LEVEL_DEBUG, "%s> io_uring: %s (fall back to synchronous hash calculation)", file->req->fullpath, reason);
+    if (file->md_initialized) {
+        close_md(&file->mdc, NULL, file->req->fullpath);
+        file->md_initialized = false;
+    }
+    file->req->done = false;
+    file->state = URING_CLOSE;
+    uring_prep(engine, file);
+}
+
+/* returns false if the file is finished */
+static bool uring_handle_completion(uring_engine *engine, uring_file *file, int res) {
+    uring_hash_request *req = file->req;
+    struct stat new_fs;
+    switch (file->state) {
+        case URING_OPEN:
+            if (res < 0) {
+#ifdef HAVE_O_NOATIME
+                if (file->open_flags&O_NOATIME) {
+                    file->open_flags &= ~O_NOATIME;
+                    uring_prep(engine, file);
+                    return true;
+                }
+#endif
+                log_msg(LOG_LEVEL_DEBUG, "%s> io_uring: openat failed: %s (fall back to synchronous hash calculation)", req->fullpath, strerror(-res));
+                req->done = false;
+                return false;
+            }
+            file->fd = res;
+            file->state = URING_STAT;
+            uring_prep(engine, file);
+            return true;
+        case URING_STAT:
+            if (res < 0) {
+                uring_fail(engine, file, "statx failed");
+                return true;
+            }
+            statx2stat(&file->stx, conf->statx_mask, &new_fs);
+            /* req->fs is owned by the caller, compare with a copy */
+            struct stat old_fs = *req->fs;
+            if(!(req->attr&ATTR(attr_rdev))) {
+                new_fs.st_rdev=0;
+                old_fs.st_rdev=0;
+            }
+            if (stat_cmp(&new_fs, &old_fs, false) != RETOK) {
+                uring_fail(engine, file, "file has been changed");
+                return true;
+            }
+            file->mdc.todo_attr = req->attr;
+            if (init_md(&file->mdc, req->fullpath) != RETOK) {
+                uring_fail(engine, file, "init_md() failed");
+                return true;
+            }
+            file->md_initialized = true;
+            file->state = URING_READ;
+            uring_prep(engine, file);
+            return true;
+        case URING_READ:
+            if (res < 0) {
+                uring_fail(engine, file, "read failed");
+            } else if (res > 0) {
+                if (update_md(&file->mdc, file->buf, res) != RETOK) {
+                    uring_fail(engine, file, "update_md() failed");
+                } else {
+                    file->offset += res;
+                    uring_prep(engine, file);
+                }
+            } else if (file->offset != req->fs->st_size) {
+                uring_fail(engine, file, "number of bytes read mismatches stat size");
+            } else {
+                close_md(&file->mdc, &req->hashsums, req->fullpath);
+                file->md_initialized = false;
+                req->done = true;
+                file->state = URING_CLOSE;
+                uring_prep(engine, file);
+            }
+            return true;
+        case URING_CLOSE:
+            return false;
+    }
+    return false;
+}
+
+/*
+ * Calculates the hashsums of up to URING_MAX_FILES files with batched
+ * openat, statx, read and close requests.
+ *
+ * Growing and compressed files and hard links are left to calc_hashsums().
+ */
+void uring_calc_hashsums(uring_engine *engine, uring_hash_request *reqs, int n) {
+    uring_file files[URING_MAX_FILES];
+    int pending = 0;
+
+    for (int i = 0 ; i < n && i < URING_MAX_FILES ; ++i) {
+        reqs[i].done = false;
+        reqs[i].hashsums.attrs = 0LLU;
+        /* hard links are left to calc_hashsums() to use the hard link cache */
+        if (reqs[i].attr&get_hashes(true) && S_ISREG(reqs[i].fs->st_mode) && reqs[i].fs->st_nlink <= 1
+                && !(reqs[i].attr&(ATTR(attr_growing)|ATTR(attr_compressed)))) {
+            files[pending] = (uring_file) {
+                .req = &reqs[i],
+                .state = URING_OPEN,
+#ifdef HAVE_O_NOATIME
+                .open_flags = O_RDONLY|O_NOATIME,
+#else
+                .open_flags = O_RDONLY,
+#endif
+                .fd = -1,
+                .offset = 0,
+                .buf = engine->bufs[pending],
+                .md_initialized = false,
+            };
+            uring_prep(engine, &files[pending]);
+            pending++;
+        }
+    }
+    log_msg(LOG_LEVEL_THREAD, "%10s: io_uring: calculate hashsums of %d file(s)", engine->whoami, pending);
+
+    while (pending) {
+        int ret = io_uring_submit_and_wait(&engine->ring, 1);
+        if (ret < 0 && ret != -EINTR) {
+            log_msg(LOG_LEVEL_ERROR, "%10s: io_uring_submit_and_wait() failed: %s", engine->whoami, strerror(-ret));
+            exit(THREAD_ERROR);
+        }
+        struct io_uring_cqe *cqe;
+        while (io_uring_peek_cqe(&engine->ring, &cqe) == 0) {
+            uring_file *file = io_uring_cqe_get_data(cqe);
+            int res = cqe->res;
+            io_uring_cqe_seen(&engine->ring, cqe);
+            if (!uring_handle_completion(engine, file, res)) {
+                pending--;
+            }
+        }
+    }
+}
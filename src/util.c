@@ -105,6 +105,15 @@ void* checked_calloc(size_t nmemb, size_t size) {
     }
     return p;
 }
+void* checked_aligned_alloc(size_t alignment, size_t size) {
+    void * p = NULL;
+    int err = posix_memalign(&p, alignment, size);
+    if (err) {
+        log_msg(LOG_LEVEL_ERROR, "posix_memalign: failed to allocate %lu bytes of memory (alignment: %lu): %s", (unsigned long) size, (unsigned long) alignment, strerror(err));
+        exit(MEMORY_ALLOCATION_FAILURE);
+    }
+    return p;
+}
 void* checked_strdup(const char *s) {
     void * p = strdup(s);
     if (p == NULL) {
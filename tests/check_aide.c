@@ -28,7 +28,12 @@ int main (void) {
 
     sr = srunner_create (make_attributes_suite());
     srunner_add_suite(sr, make_base64_suite());
+    srunner_add_suite(sr, make_do_md_suite());
+    srunner_add_suite(sr, make_hash_cache_suite());
+    srunner_add_suite(sr, make_hashsum_suite());
+    srunner_add_suite(sr, make_native_hash_suite());
     srunner_add_suite(sr, make_progress_suite());
+    srunner_add_suite(sr, make_ring_suite());
     srunner_add_suite(sr, make_seltree_suite());
 
     srunner_run_all (sr, CK_NORMAL);
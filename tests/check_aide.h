@@ -22,5 +22,10 @@
 
 Suite *make_attributes_suite(void);
 Suite *make_base64_suite(void);
+Suite *make_do_md_suite(void);
+Suite *make_hash_cache_suite(void);
+Suite *make_hashsum_suite(void);
+Suite *make_native_hash_suite(void);
 Suite *make_progress_suite(void);
+Suite *make_ring_suite(void);
 Suite *make_seltree_suite(void);
@@ -69,6 +69,11 @@ static diff_attributes_t diff_attributes_tests[] = {
     { 0, ATTR(attr_ftype), "ftype" },
     { 0, ATTR(attr_e2fsattrs), "e2fsattrs" },
     { 0, ATTR(attr_capabilities), "caps" },
+    { 0, ATTR(attr_btime), "btime" },
+    { 0, ATTR(attr_blake3), "blake3" },
+    { 0, ATTR(attr_xxh3), "xxh3" },
+    { 0, ATTR(attr_crc32c), "crc32c" },
+    { 0, ATTR(attr_trustctime), "trustctime" },
 
     { 0, ATTR(attr_linkname)|ATTR(attr_perm), "l+p" },
     { 0, ATTR(attr_ctime)|ATTR(attr_ftype), "c+ftype" },
@@ -0,0 +1,141 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <check.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "aide.h"
+#include "attributes.h"
+#include "db_config.h"
+#include "do_md.h"
+#include "hashsum.h"
+#include "md.h"
+#include "util.h"
+
+/* calc_hashsums() is configured by the global config */
+db_config *conf = NULL;
+
+#define TRUNCATE_FILE_SIZE (32*1024*1024)
+#define TRUNCATE_ITERATIONS 10
+
+typedef struct truncate_job {
+    char *path;
+    long delay_us;
+} truncate_job;
+
+static void setup_conf(void) {
+    conf = checked_calloc(1, sizeof(db_config));
+    conf->read_block_size = 1024*1024;
+    conf->native_hashsums = true;
+    conf->blake3_threads = 1;
+#ifdef HAVE_STATX
+    conf->statx_mask = STATX_BASIC_STATS;
+#endif
+}
+
+static void teardown_conf(void) {
+    free(conf);
+    conf = NULL;
+}
+
+static void *truncate_file(void *arg) {
+    truncate_job *job = arg;
+    struct timespec delay = { 0, job->delay_us * 1000 };
+    nanosleep(&delay, NULL);
+    ck_assert_int_eq(truncate(job->path, 0), 0);
+    return NULL;
+}
+
+static md_hashsums calc_test_hashsums(char *path, DB_ATTR_TYPE attr) {
+    struct stat fs;
+    ck_assert_int_eq(stat_masked(AT_FDCWD, path, &fs, NULL, 0), 0);
+    return calc_hashsums(path, attr, &fs, -1, false);
+}
+
+typedef struct truncate_test {
+    DB_ATTR_TYPE attr;
+    long long hash_threads_threshold;
+    long blake3_threads;
+} truncate_test;
+
+static truncate_test truncate_tests[] = {
+    { ATTR(attr_sha256)|ATTR(attr_sha512), 1, 1 }, /* md threads */
+    { ATTR(attr_blake3), 0, 4 }, /* blake3 subtree threads */
+};
+
+/* the file is truncated while its hashsums are calculated, this must not kill the process (SIGBUS) */
+START_TEST (test_calc_hashsums_truncate_threads) {
+    DB_ATTR_TYPE attr = truncate_tests[_i].attr;
+
+    conf->mmap_threshold = 1;
+    conf->hash_threads_threshold = truncate_tests[_i].hash_threads_threshold;
+    conf->blake3_threads = truncate_tests[_i].blake3_threads;
+
+    char path[] = "check_do_md.XXXXXX";
+    int fd = mkstemp(path);
+    ck_assert_int_ge(fd, 0);
+    close(fd);
+
+    ck_assert_int_eq(truncate(path, TRUNCATE_FILE_SIZE), 0);
+    md_hashsums expected = calc_test_hashsums(path, attr);
+    ck_assert(expected.attrs == attr);
+
+    for (int i = 0 ; i < TRUNCATE_ITERATIONS ; ++i) {
+        ck_assert_int_eq(truncate(path, TRUNCATE_FILE_SIZE), 0);
+        truncate_job job = { path, i * 500 };
+        pthread_t thread;
+        ck_assert_int_eq(pthread_create(&thread, NULL, &truncate_file, &job), 0);
+        md_hashsums hs = calc_test_hashsums(path, attr);
+        pthread_join(thread, NULL);
+        /* either failed or calculated before the file was truncated */
+        if (hs.attrs) {
+            ck_assert(hs.attrs == attr);
+            for (int j = 0 ; j < num_hashes ; ++j) {
+                if (attr&ATTR(hashsums[j].attribute)) {
+                    ck_assert_mem_eq(hs.hashsums[j], expected.hashsums[j], hashsums[j].length);
+                }
+            }
+        }
+    }
+    unlink(path);
+}
+END_TEST
+
+Suite *make_do_md_suite(void) {
+
+    Suite *s = suite_create ("do_md");
+
+    TCase *tc_calc_hashsums = tcase_create ("calc_hashsums");
+
+    tcase_add_checked_fixture (tc_calc_hashsums, setup_conf, teardown_conf);
+    tcase_set_timeout (tc_calc_hashsums, 30);
+    tcase_add_loop_test (tc_calc_hashsums, test_calc_hashsums_truncate_threads, 0, sizeof(truncate_tests)/sizeof(truncate_test));
+
+    suite_add_tcase (s, tc_calc_hashsums);
+
+    return s;
+}
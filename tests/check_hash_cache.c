@@ -0,0 +1,137 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash_cache.h"
+#include "attributes.h"
+#include "hashsum.h"
+
+static struct stat get_test_stat(ino_t ino) {
+    struct stat fs;
+    memset(&fs, 0, sizeof(fs));
+    fs.st_mode = S_IFREG|0644;
+    fs.st_dev = 42;
+    fs.st_ino = ino;
+    fs.st_size = 1024;
+    fs.st_mtim.tv_sec = 1700000000;
+    fs.st_mtim.tv_nsec = 123456789;
+    fs.st_ctim.tv_sec = 1700000001;
+    fs.st_ctim.tv_nsec = 987654321;
+    return fs;
+}
+
+static md_hashsums get_test_hashsums(DB_ATTR_TYPE attrs, unsigned char seed) {
+    md_hashsums hs;
+    for (int i = 0 ; i < num_hashes ; ++i) {
+        memset(hs.hashsums[i], seed + i, HASHSUM_MAX_LENGTH);
+    }
+    hs.attrs = attrs;
+    return hs;
+}
+
+static char *get_cache_path(void) {
+    char *path = strdup("check_hash_cache.XXXXXX");
+    int fd = mkstemp(path);
+    ck_assert_int_ge(fd, 0);
+    close(fd);
+    unlink(path);
+    return path;
+}
+
+START_TEST (test_hash_cache_roundtrip) {
+    char *path = get_cache_path();
+    DB_ATTR_TYPE sha256 = ATTR(attr_sha256);
+    DB_ATTR_TYPE sha512 = ATTR(attr_sha512);
+    md_hashsums hs;
+
+    hash_cache_open(path);
+    struct stat fs = get_test_stat(1000);
+    ck_assert(!get_cached_hashsums("file", sha256, &fs, NULL));
+
+    for (ino_t ino = 1000 ; ino < 1100 ; ++ino) {
+        fs = get_test_stat(ino);
+        hs = get_test_hashsums(sha256|sha512, ino);
+        add_cached_hashsums(&fs, &hs);
+    }
+    ck_assert(hash_cache_write(false));
+    hash_cache_close();
+
+    hash_cache_open(path);
+    for (ino_t ino = 1000 ; ino < 1100 ; ++ino) {
+        fs = get_test_stat(ino);
+        md_hashsums expected = get_test_hashsums(sha256|sha512, ino);
+        memset(&hs, 0, sizeof(hs));
+        ck_assert(get_cached_hashsums("file", sha256|sha512, &fs, &hs));
+        ck_assert(hs.attrs == (sha256|sha512));
+        ck_assert_mem_eq(hs.hashsums[hash_sha256], expected.hashsums[hash_sha256], hashsums[hash_sha256].length);
+        ck_assert_mem_eq(hs.hashsums[hash_sha512], expected.hashsums[hash_sha512], hashsums[hash_sha512].length);
+    }
+
+    fs = get_test_stat(1000);
+    ck_assert(!get_cached_hashsums("file", ATTR(attr_sha1), &fs, NULL));
+    fs.st_mtim.tv_nsec++;
+    ck_assert(!get_cached_hashsums("file", sha256, &fs, NULL));
+    fs = get_test_stat(1000);
+    fs.st_size++;
+    ck_assert(!get_cached_hashsums("file", sha256, &fs, NULL));
+    fs = get_test_stat(2000);
+    ck_assert(!get_cached_hashsums("file", sha256, &fs, NULL));
+    hash_cache_close();
+
+    unlink(path);
+    free(path);
+}
+END_TEST
+
+START_TEST (test_hash_cache_invalid_file) {
+    char *path = get_cache_path();
+    FILE *f = fopen(path, "w");
+    ck_assert_ptr_nonnull(f);
+    fputs("AIDEHC01 but not a hash cache", f);
+    fclose(f);
+
+    hash_cache_open(path);
+    struct stat fs = get_test_stat(1000);
+    ck_assert(!get_cached_hashsums("file", ATTR(attr_sha256), &fs, NULL));
+    hash_cache_close();
+
+    unlink(path);
+    free(path);
+}
+END_TEST
+
+Suite *make_hash_cache_suite(void) {
+
+    Suite *s = suite_create ("hash_cache");
+
+    TCase *tc_hash_cache = tcase_create ("hash_cache");
+
+    tcase_add_test (tc_hash_cache, test_hash_cache_roundtrip);
+    tcase_add_test (tc_hash_cache, test_hash_cache_invalid_file);
+
+    suite_add_tcase (s, tc_hash_cache);
+
+    return s;
+}
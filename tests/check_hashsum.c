@@ -0,0 +1,60 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <check.h>
+#ifdef WITH_GCRYPT
+#include <gcrypt.h>
+#endif
+
+#include "attributes.h"
+#include "hashsum.h"
+
+/* hashsums only calculated by the built-in implementations */
+static DB_ATTR_TYPE native_only = ATTR(attr_blake3)|ATTR(attr_xxh3)|ATTR(attr_crc32c);
+
+START_TEST (test_get_hashes_native_only) {
+    /* H and the default database_attrs must not be extended by the built-in only hashsums */
+    ck_assert((get_hashes(false)&native_only) == 0);
+    ck_assert((get_hashes(true)&native_only) == native_only);
+
+    ck_assert((get_available_hashes()&get_hashes(false)) == get_hashes(false));
+#ifdef WITH_GCRYPT
+    if (gcry_fips_mode_active()) {
+        ck_assert((get_available_hashes()&native_only) == 0);
+        return;
+    }
+#endif
+    ck_assert((get_available_hashes()&native_only) == native_only);
+}
+END_TEST
+
+Suite *make_hashsum_suite(void) {
+
+    Suite *s = suite_create ("hashsum");
+
+    TCase *tc_get_hashes = tcase_create ("get_hashes");
+
+    tcase_add_test (tc_get_hashes, test_get_hashes_native_only);
+
+    suite_add_tcase (s, tc_get_hashes);
+
+    return s;
+}
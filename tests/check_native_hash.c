@@ -0,0 +1,207 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "native_hash.h"
+
+typedef struct {
+    HASHSUM hashsum;
+    const char *input;
+    const char *output;
+} native_hash_vector_t;
+
+static native_hash_vector_t vectors[] = {
+    { hash_sha1, "abc", "a9993e364706816aba3e25717850c26c9cd0d89d" },
+    { hash_sha1, "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+        "84983e441c3bd26ebaae4aa1f95129e5e54670f1" },
+    { hash_sha256, "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { hash_sha256, "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { hash_sha256, "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    { hash_sha512, "abc",
+        "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+        "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" },
+    { hash_sha512, "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno"
+        "ijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+        "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+        "501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909" },
+#ifdef WITH_GCRYPT
+    { hash_crc32, "123456789", "cbf43926" },
+#endif
+    { hash_blake3, "", "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262" },
+    { hash_blake3, "abc", "6437b3ac38465133ffb63b75273a8db548c558465d79db03fd359c6cd5bd9d85" },
+    { hash_xxh3, "", "2d06800538d394c2" },
+    { hash_xxh3, "abc", "78af5f94892f3950" },
+    { hash_crc32c, "123456789", "e3069283" },
+};
+
+/* one million times 'a' */
+static native_hash_vector_t million_a_vectors[] = {
+    { hash_sha256, NULL, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+    { hash_xxh3, NULL, "b1fd6fae5285c4eb" },
+    { hash_crc32c, NULL, "436fe240" },
+};
+
+static int hashsum_length(HASHSUM hashsum) {
+    switch (hashsum) {
+        case hash_sha1: return 20;
+        case hash_sha256: return 32;
+        case hash_sha512: return 64;
+        case hash_blake3: return 32;
+        case hash_xxh3: return 8;
+        default: return 4;
+    }
+}
+
+static void hex(const unsigned char *hashsum, int length, char *str) {
+    for (int i = 0 ; i < length ; ++i) {
+        snprintf(&str[2*i], 3, "%02x", hashsum[i]);
+    }
+}
+
+START_TEST (test_native_hash_vectors) {
+    native_hash_vector_t v = vectors[_i];
+    native_hash_ctx ctx;
+    unsigned char hashsum[64];
+    char str[129];
+
+    ck_assert(native_hash_available(v.hashsum));
+    ck_assert_ptr_nonnull(native_hash_implementation(v.hashsum));
+
+    native_hash_init(&ctx, v.hashsum);
+    native_hash_update(&ctx, v.input, strlen(v.input));
+    native_hash_final(&ctx, hashsum);
+    hex(hashsum, hashsum_length(v.hashsum), str);
+    ck_assert_str_eq(str, v.output);
+
+    /* same hashsum if the data is passed byte by byte */
+    native_hash_init(&ctx, v.hashsum);
+    for (size_t i = 0 ; i < strlen(v.input) ; ++i) {
+        native_hash_update(&ctx, &v.input[i], 1);
+    }
+    native_hash_final(&ctx, hashsum);
+    hex(hashsum, hashsum_length(v.hashsum), str);
+    ck_assert_str_eq(str, v.output);
+}
+END_TEST
+
+START_TEST (test_native_hash_million_a) {
+    native_hash_vector_t v = million_a_vectors[_i];
+    static char a[1000];
+    native_hash_ctx ctx;
+    unsigned char hashsum[64];
+    char str[129];
+
+    memset(a, 'a', sizeof(a));
+    native_hash_init(&ctx, v.hashsum);
+    for (int i = 0 ; i < 1000 ; ++i) {
+        native_hash_update(&ctx, a, sizeof(a));
+    }
+    native_hash_final(&ctx, hashsum);
+    hex(hashsum, hashsum_length(v.hashsum), str);
+    ck_assert_str_eq(str, v.output);
+}
+END_TEST
+
+START_TEST (test_native_hash_blake3_tree) {
+    const size_t length = 1024*1024 + 1;
+    unsigned char *data = malloc(length);
+    native_hash_ctx ctx;
+    unsigned char hashsum[32];
+    char str[65];
+
+    for (size_t i = 0 ; i < length ; ++i) {
+        data[i] = i % 251;
+    }
+    /* the hash tree is the same for every split of the data and number of threads */
+    for (int threads = 1 ; threads <= 4 ; threads *= 2) {
+        native_hash_init(&ctx, hash_blake3);
+        native_hash_set_threads(&ctx, threads);
+        native_hash_update(&ctx, data, 3000);
+        native_hash_update(&ctx, data + 3000, length - 3000);
+        native_hash_final(&ctx, hashsum);
+        hex(hashsum, 32, str);
+        ck_assert_str_eq(str, "2f053cd7472cf0cd2f9adaf45c1180255b91b9a865404a63671a0ee5f792ed33");
+    }
+    free(data);
+}
+END_TEST
+
+/* padding boundaries (55/56/64 bytes) and uneven lengths to refill the lanes at different times */
+static const size_t multi_lengths[] = { 0, 1, 55, 56, 57, 63, 64, 65, 119, 120, 128, 3, 1000, 0, 4097, 56, 200, 64, 9, 777, 55, 130 };
+#define NUM_MULTI_LENGTHS (sizeof(multi_lengths)/sizeof(size_t))
+
+static void check_sha256_multi(const unsigned char *data) {
+    const unsigned char *messages[NUM_MULTI_LENGTHS];
+    unsigned char digests[NUM_MULTI_LENGTHS][32];
+    unsigned char expected[32];
+    native_hash_ctx ctx;
+
+    for (size_t i = 0 ; i < NUM_MULTI_LENGTHS ; ++i) {
+        messages[i] = data + 13*i;
+    }
+    /* every number of messages, more than 8 ones need several rounds of lanes */
+    for (size_t n = 1 ; n <= NUM_MULTI_LENGTHS ; ++n) {
+        memset(digests, 0, sizeof(digests));
+        native_hash_sha256_multi(messages, multi_lengths, n, digests);
+        for (size_t i = 0 ; i < n ; ++i) {
+            native_hash_init(&ctx, hash_sha256);
+            native_hash_update(&ctx, messages[i], multi_lengths[i]);
+            native_hash_final(&ctx, expected);
+            ck_assert_mem_eq(digests[i], expected, 32);
+        }
+    }
+}
+
+START_TEST (test_native_hash_sha256_multi) {
+    unsigned char *data = malloc(13*NUM_MULTI_LENGTHS + 4097);
+
+    for (size_t i = 0 ; i < 13*NUM_MULTI_LENGTHS + 4097 ; ++i) {
+        data[i] = i % 251;
+    }
+    check_sha256_multi(data);
+    /* the multi-buffer implementation is not used by default on CPUs with SHA-NI */
+    if (!native_hash_sha256_multi_buffer() && native_hash_force_sha256_multi_buffer()) {
+        check_sha256_multi(data);
+    }
+    free(data);
+}
+END_TEST
+
+Suite *make_native_hash_suite(void) {
+
+    Suite *s = suite_create ("native_hash");
+
+    TCase *tc_native_hash = tcase_create ("native_hash");
+
+    tcase_add_loop_test (tc_native_hash, test_native_hash_vectors, 0, sizeof(vectors)/sizeof(native_hash_vector_t));
+    tcase_add_loop_test (tc_native_hash, test_native_hash_million_a, 0, sizeof(million_a_vectors)/sizeof(native_hash_vector_t));
+    tcase_add_test (tc_native_hash, test_native_hash_blake3_tree);
+    tcase_add_test (tc_native_hash, test_native_hash_sha256_multi);
+
+    suite_add_tcase (s, tc_native_hash);
+
+    return s;
+}
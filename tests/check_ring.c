@@ -0,0 +1,134 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2024 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <check.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "ring.h"
+
+#define RING_PRODUCERS 4
+#define RING_CONSUMERS 4
+#define RING_ELEMENTS 100000L
+
+static ring_ts_t *ring;
+
+START_TEST (test_ring_capacity) {
+    ring_ts_t *r = ring_ts_init(5);
+    ck_assert_uint_eq(ring_ts_capacity(r), 8);
+    ring_ts_free(r);
+
+    r = ring_ts_init(64);
+    ck_assert_uint_eq(ring_ts_capacity(r), 64);
+    ring_ts_free(r);
+}
+END_TEST
+
+START_TEST (test_ring_fifo) {
+    long values[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    ring_ts_t *r = ring_ts_init(8);
+
+    ck_assert_ptr_null(ring_ts_dequeue(r, "(test)"));
+    for (int i = 0 ; i < 8 ; ++i) {
+        ck_assert(ring_ts_try_enqueue(r, &values[i]));
+    }
+    ck_assert(!ring_ts_try_enqueue(r, &values[0]));
+    ck_assert_uint_eq(ring_ts_size(r), 8);
+
+    void *batch[3];
+    ck_assert_uint_eq(ring_ts_dequeue_batch_wait(r, batch, 3, "(test)"), 3);
+    for (int i = 0 ; i < 3 ; ++i) {
+        ck_assert_ptr_eq(batch[i], &values[i]);
+    }
+    for (int i = 3 ; i < 8 ; ++i) {
+        ck_assert_ptr_eq(ring_ts_dequeue(r, "(test)"), &values[i]);
+    }
+
+    ring_ts_release(r, "(test)");
+    ck_assert_ptr_null(ring_ts_dequeue_wait(r, "(test)"));
+    ck_assert_uint_eq(ring_ts_dequeue_batch_wait(r, batch, 3, "(test)"), 0);
+    ring_ts_free(r);
+}
+END_TEST
+
+static void *ring_producer(void *arg) {
+    long base = (long) arg * RING_ELEMENTS;
+    for (long i = 1 ; i <= RING_ELEMENTS ; ++i) {
+        ring_ts_enqueue(ring, (void *) (base + i), "(producer)");
+    }
+    return NULL;
+}
+
+static void *ring_consumer(void *arg) {
+    long *sum = arg;
+    void *batch[16];
+    size_t n;
+    while ((n = ring_ts_dequeue_batch_wait(ring, batch, 16, "(consumer)")) > 0) {
+        for (size_t i = 0 ; i < n ; ++i) {
+            *sum += (long) batch[i];
+        }
+    }
+    return NULL;
+}
+
+START_TEST (test_ring_threads) {
+    pthread_t producers[RING_PRODUCERS];
+    pthread_t consumers[RING_CONSUMERS];
+    long sums[RING_CONSUMERS] = { 0 };
+
+    /* small capacity to exercise waiting producers and consumers */
+    ring = ring_ts_init(16);
+    for (long i = 0 ; i < RING_CONSUMERS ; ++i) {
+        ck_assert_int_eq(pthread_create(&consumers[i], NULL, &ring_consumer, &sums[i]), 0);
+    }
+    for (long i = 0 ; i < RING_PRODUCERS ; ++i) {
+        ck_assert_int_eq(pthread_create(&producers[i], NULL, &ring_producer, (void *) i), 0);
+    }
+    for (int i = 0 ; i < RING_PRODUCERS ; ++i) {
+        pthread_join(producers[i], NULL);
+    }
+    ring_ts_release(ring, "(test)");
+
+    long sum = 0;
+    for (int i = 0 ; i < RING_CONSUMERS ; ++i) {
+        pthread_join(consumers[i], NULL);
+        sum += sums[i];
+    }
+    ring_ts_free(ring);
+
+    long n = RING_PRODUCERS * RING_ELEMENTS;
+    ck_assert_int_eq(sum, n * (n + 1) / 2);
+}
+END_TEST
+
+Suite *make_ring_suite(void) {
+
+    Suite *s = suite_create ("ring");
+
+    TCase *tc_ring = tcase_create ("ring");
+
+    tcase_add_test (tc_ring, test_ring_capacity);
+    tcase_add_test (tc_ring, test_ring_fifo);
+    tcase_add_test (tc_ring, test_ring_threads);
+
+    suite_add_tcase (s, tc_ring);
+
+    return s;
+}